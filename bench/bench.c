@@ -0,0 +1,238 @@
+/**
+ *  Copyright 2014 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  bench.c
+ *  lua-base64mix
+ *
+ *  microbenchmark of the encode/decode kernels.
+ *
+ *  usage: bench [max-bytes [min-seconds]]
+ *
+ *  the results are printed to stdout in CSV format;
+ *    kernel,op,bytes,iterations,ns_per_op,mb_per_s,cycles_per_byte
+ *  bytes is the length of the raw (decoded) data, and mb_per_s is computed
+ *  from it for both encode and decode. cycles_per_byte is empty if the cycle
+ *  counter is not available.
+ */
+
+#include "base64mix.h"
+#include <stdio.h>
+#include <time.h>
+#if defined(B64M_X86)
+# include <x86intrin.h>
+#endif
+
+#define BENCH_MIN_BYTES ((size_t)8)
+#define BENCH_MAX_BYTES ((size_t)256 * 1024 * 1024)
+
+typedef struct {
+    const char *name;
+    int decode;
+    const unsigned char *tbl;
+} bench_op_t;
+
+static const bench_op_t OPS[] = {
+    {"encode_std", 0, BASE64MIX_STDENC},
+    {"encode_url", 0, BASE64MIX_URLENC},
+    {"decode_std", 1, BASE64MIX_STDDEC},
+    {"decode_url", 1, BASE64MIX_URLDEC},
+    {"decode_mix", 1, BASE64MIX_DEC   },
+};
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static inline uint64_t cycles(void)
+{
+#if defined(B64M_X86)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/**
+ * getkernels stores the kernels supported by the running CPU into kernels
+ * and returns the number of them. the scalar kernel is always the first.
+ */
+static size_t getkernels(b64m_kernel_t kernels[4])
+{
+    size_t n = 0;
+
+    kernels[n++] = B64M_KERNEL;
+    b64m_init();
+#if defined(B64M_X86)
+    if (__builtin_cpu_supports("ssse3")) {
+        kernels[n++] = (b64m_kernel_t){
+            .name     = "ssse3",
+            .encode   = b64m_encode_ssse3,
+            .decode   = b64m_decode_ssse3,
+            .validate = b64m_validate_ssse3,
+        };
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels[n++] = (b64m_kernel_t){
+            .name     = "avx2",
+            .encode   = b64m_encode_avx2,
+            .decode   = b64m_decode_avx2,
+            .validate = b64m_validate_avx2,
+        };
+    }
+#else
+    if (B64M_KERNEL.encode != kernels[0].encode) {
+        kernels[n++] = B64M_KERNEL;
+    }
+#endif
+    return n;
+}
+
+static void run(const char *kname, const bench_op_t *op, unsigned char *dst,
+                const unsigned char *src, size_t len, size_t bytes,
+                double mintime)
+{
+    size_t iter    = 0;
+    double elapsed = 0;
+    uint64_t ncyc  = 0;
+    double t       = 0;
+    uint64_t c     = 0;
+
+    // warm up, and verify that the input is processed successfully
+    if (op->decode && b64m_decode_raw(dst, src, len, op->tbl) != bytes) {
+        fprintf(stderr, "%s: %s failed\n", kname, op->name);
+        exit(EXIT_FAILURE);
+    } else if (!op->decode) {
+        b64m_encode_raw(dst, src, len, op->tbl);
+    }
+
+    // repeat until the elapsed time exceeds mintime
+    t = now();
+    c = cycles();
+    do {
+        size_t i = 0;
+        size_t n = iter ? iter : 1;
+
+        for (; i < n; i++) {
+            if (op->decode) {
+                b64m_decode_raw(dst, src, len, op->tbl);
+            } else {
+                b64m_encode_raw(dst, src, len, op->tbl);
+            }
+        }
+        iter += n;
+        elapsed = now() - t;
+    } while (elapsed < mintime);
+    ncyc = cycles() - c;
+
+    printf("%s,%s,%zu,%zu,%.1f,%.1f,", kname, op->name, bytes, iter,
+           elapsed * 1e9 / iter, bytes * iter / elapsed / 1e6);
+    if (ncyc) {
+        printf("%.3f", (double)ncyc / iter / bytes);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t maxbytes    = BENCH_MAX_BYTES;
+    double mintime     = 0.2;
+    b64m_kernel_t kernels[4];
+    size_t nkernel     = getkernels(kernels);
+    unsigned char *src = NULL;
+    unsigned char *enc = NULL;
+    unsigned char *url = NULL;
+    unsigned char *dec = NULL;
+    unsigned char *out = NULL;
+    size_t i           = 0;
+    size_t bytes       = 0;
+
+    if (argc > 1) {
+        maxbytes = strtoull(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        mintime = strtod(argv[2], NULL);
+    }
+    if (maxbytes < BENCH_MIN_BYTES) {
+        fprintf(stderr, "max-bytes must be at least %zu\n", BENCH_MIN_BYTES);
+        return EXIT_FAILURE;
+    } else if ((bytes = b64m_encoded_len(maxbytes, 1)) == SIZE_MAX) {
+        perror("max-bytes");
+        return EXIT_FAILURE;
+    }
+
+    src = malloc(maxbytes);
+    enc = malloc(bytes);
+    url = malloc(bytes);
+    out = malloc(bytes);
+    dec = malloc(maxbytes);
+    if (!src || !enc || !url || !out || !dec) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    srand(0);
+    for (i = 0; i < maxbytes; i++) {
+        src[i] = rand();
+    }
+
+    printf("kernel,op,bytes,iterations,ns_per_op,mb_per_s,cycles_per_byte\n");
+    // measure the sizes of powers of 8 and the maximum size
+    for (bytes = BENCH_MIN_BYTES;; bytes *= 8) {
+        size_t elen = 0;
+        size_t ulen = 0;
+
+        if (bytes > maxbytes) {
+            bytes = maxbytes;
+        }
+        elen = b64m_encode_raw(enc, src, bytes, BASE64MIX_STDENC);
+        ulen = b64m_encode_raw(url, src, bytes, BASE64MIX_URLENC);
+        for (i = 0; i < nkernel; i++) {
+            size_t j = 0;
+
+            B64M_KERNEL = kernels[i];
+            for (; j < sizeof(OPS) / sizeof(OPS[0]); j++) {
+                const bench_op_t *op = &OPS[j];
+
+                if (!op->decode) {
+                    run(kernels[i].name, op, out, src, bytes, bytes, mintime);
+                } else if (op->tbl == BASE64MIX_STDDEC) {
+                    run(kernels[i].name, op, dec, enc, elen, bytes, mintime);
+                } else {
+                    run(kernels[i].name, op, dec, url, ulen, bytes, mintime);
+                }
+            }
+        }
+        if (bytes == maxbytes) {
+            break;
+        }
+    }
+
+    free(src);
+    free(enc);
+    free(url);
+    free(out);
+    free(dec);
+    return EXIT_SUCCESS;
+}
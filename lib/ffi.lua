@@ -0,0 +1,151 @@
+--
+-- Copyright (C) 2014 Masatoshi Teruya
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to
+-- deal in the Software without restriction, including without limitation the
+-- rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+-- sell copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+-- FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+-- IN THE SOFTWARE.
+--
+-- lib/ffi.lua
+-- lua-base64mix
+--
+-- LuaJIT FFI binding of the C ABI exported from base64mix.so.
+-- the functions of this module can be compiled by the JIT compiler because
+-- they do not go through the Lua C API.
+--
+local ffi = require('ffi')
+local C = ffi.C
+local errno = ffi.errno
+local tostr = ffi.string
+local type = type
+
+-- these declarations must be kept in sync with src/base64mix_abi.h
+ffi.cdef [[
+char *strerror(int errnum);
+
+const char *base64mix_init(void);
+size_t base64mix_encoded_len(size_t len, int pad);
+size_t base64mix_decoded_len(const unsigned char *src, size_t len);
+ssize_t base64mix_encode_into(unsigned char *dst, size_t dstlen,
+                              const unsigned char *src, size_t len,
+                              int alphabet, int pad);
+ssize_t base64mix_decode_into(unsigned char *dst, size_t dstlen,
+                              const unsigned char *src, size_t len,
+                              int alphabet);
+]]
+
+local ALPHABET = {
+    std = 0,
+    url = 1,
+    mix = 2,
+}
+local SIZE_MAX = ffi.cast('size_t', -1)
+local LIB = ffi.load(assert(package.searchpath('base64mix', package.cpath)))
+local KERNEL = tostr(LIB.base64mix_init())
+
+--- toalphabet converts the alphabet name to the constant of the C ABI
+--- @param alphabet? string
+--- @param def string
+--- @return integer
+local function toalphabet(alphabet, def)
+    local v = ALPHABET[alphabet or def]
+    if not v then
+        error('invalid alphabet: ' .. tostring(alphabet), 3)
+    end
+    return v
+end
+
+--- strerror returns the message of the current errno
+--- @return string
+local function strerror()
+    return tostr(C.strerror(errno()))
+end
+
+--- encodedLen returns the length of the string that the len bytes are
+--- encoded into.
+--- @param len integer
+--- @param pad? boolean
+--- @return integer? len
+--- @return string? err
+local function encodedLen(len, pad)
+    local n = LIB.base64mix_encoded_len(len, pad == false and 0 or 1)
+    if n == SIZE_MAX then
+        return nil, strerror()
+    end
+    return tonumber(n)
+end
+
+--- decodedLen returns the length of the bytes that the len bytes of src are
+--- decoded into.
+--- @param src string|ffi.cdata*
+--- @param len? integer
+--- @return integer len
+local function decodedLen(src, len)
+    if type(src) == 'string' then
+        len = len or #src
+    end
+    return tonumber(LIB.base64mix_decoded_len(src, len))
+end
+
+--- encodeInto encodes the len bytes of src into dst of dstlen bytes.
+--- @param dst ffi.cdata*
+--- @param dstlen integer
+--- @param src string|ffi.cdata*
+--- @param len? integer
+--- @param alphabet? string 'std' or 'url' (default: 'std')
+--- @param pad? boolean (default: true)
+--- @return integer? n
+--- @return string? err
+local function encodeInto(dst, dstlen, src, len, alphabet, pad)
+    if type(src) == 'string' then
+        len = len or #src
+    end
+    local n = LIB.base64mix_encode_into(dst, dstlen, src, len,
+                                        toalphabet(alphabet, 'std'),
+                                        pad == false and 0 or 1)
+    if n < 0 then
+        return nil, strerror()
+    end
+    return tonumber(n)
+end
+
+--- decodeInto decodes the len bytes of src into dst of dstlen bytes.
+--- @param dst ffi.cdata*
+--- @param dstlen integer
+--- @param src string|ffi.cdata*
+--- @param len? integer
+--- @param alphabet? string 'std', 'url' or 'mix' (default: 'std')
+--- @return integer? n
+--- @return string? err
+local function decodeInto(dst, dstlen, src, len, alphabet)
+    if type(src) == 'string' then
+        len = len or #src
+    end
+    local n = LIB.base64mix_decode_into(dst, dstlen, src, len,
+                                        toalphabet(alphabet, 'std'))
+    if n < 0 then
+        return nil, strerror()
+    end
+    return tonumber(n)
+end
+
+return {
+    kernel = KERNEL,
+    encodedLen = encodedLen,
+    decodedLen = decodedLen,
+    encodeInto = encodeInto,
+    decodeInto = decodeInto,
+}
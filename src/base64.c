@@ -27,6 +27,8 @@
  */
 
 #include "base64mix.h"
+#include "base64mix_abi.h"
+#include "base64mix_pool.h"
 #include <ctype.h>
 #include <errno.h>
 #include <lauxlib.h>
@@ -42,41 +44,780 @@
         lua_rawset(L, -3);                                                     \
     } while (0)
 
-#define encode_lua(L, fn)                                                      \
+#if LUA_VERSION_NUM < 502
+/**
+ * luaL_buffinitsize and luaL_pushresultsize for Lua 5.1 and LuaJIT.
+ * if the requested size does not fit into the buffer of luaL_Buffer, a
+ * userdata is pushed onto the stack and used as the buffer instead.
+ */
+static char *lb64m_buffinitsize(lua_State *L, luaL_Buffer *b, size_t sz)
+{
+    luaL_buffinit(L, b);
+    if (sz <= LUAL_BUFFERSIZE) {
+        return luaL_prepbuffer(b);
+    }
+    b->p = NULL;
+    return lua_newuserdata(L, sz);
+}
+
+static void lb64m_pushresultsize(luaL_Buffer *b, size_t sz)
+{
+    if (b->p) {
+        luaL_addsize(b, sz);
+        luaL_pushresult(b);
+        return;
+    }
+    lua_pushlstring(b->L, lua_touserdata(b->L, -1), sz);
+    lua_remove(b->L, -2);
+}
+
+# define luaL_buffinitsize(L, b, sz) lb64m_buffinitsize(L, b, sz)
+# define luaL_pushresultsize(b, sz)  lb64m_pushresultsize(b, sz)
+# define lua_rawlen(L, idx)          lua_objlen(L, idx)
+#endif
+
+/**
+ * counters of the module functions
+ *
+ * the counters are process-wide, and they are compiled out if
+ * BASE64MIX_NO_STATS is defined.
+ */
+#define STATS_LIST(X)                                                          \
+    X(ENCODE, "encode")                                                        \
+    X(ENCODE_URL, "encodeURL")                                                 \
+    X(ENCODE_TO, "encodeTo")                                                   \
+    X(ENCODE_URL_TO, "encodeURLTo")                                            \
+    X(DECODE, "decode")                                                        \
+    X(DECODE_URL, "decodeURL")                                                 \
+    X(DECODE_MIX, "decodeMix")                                                 \
+    X(DECODE_CACHED, "decodeCached")                                           \
+    X(DECODE_SEGMENTS, "decodeSegments")                                       \
+    X(DECODE_RANGE, "decodeRange")                                             \
+    X(TO_URL, "toURL")                                                         \
+    X(TO_STD, "toStd")                                                         \
+    X(ENCODE_JOB, "encodeJob")                                                 \
+    X(DECODE_JOB, "decodeJob")                                                 \
+    X(ENCODE_MIME, "encodeMIME")                                               \
+    X(DECODE_MIME, "decodeMIME")                                               \
+    X(ENCODE_BATCH, "encodeBatch")                                             \
+    X(ENCODE_URL_BATCH, "encodeURLBatch")                                      \
+    X(DECODE_BATCH, "decodeBatch")                                             \
+    X(DECODE_URL_BATCH, "decodeURLBatch")                                      \
+    X(DECODE_MIX_BATCH, "decodeMixBatch")                                      \
+    X(ENCODER, "encoder")                                                      \
+    X(DECODER, "decoder")                                                      \
+    X(CODEC, "codec")                                                          \
+    X(ENCODE_INT, "encodeInt")                                                 \
+    X(DECODE_INT, "decodeInt")                                                 \
+    X(IS_VALID, "isValid")                                                     \
+    X(ENCODED_LEN, "encodedLen")                                               \
+    X(DECODED_LEN, "decodedLen")
+
+#define STATS_ID(id, name) STATS_##id,
+enum {
+    STATS_LIST(STATS_ID) STATS_MAX
+};
+#undef STATS_ID
+
+#if defined(BASE64MIX_NO_STATS)
+# define stats_update(id, nin, nout) ((void)(id))
+# define stats_error(id)             ((void)(id))
+# define stats_alloc(id)             ((void)(id))
+#else
+typedef struct {
+    uint64_t calls;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t errors;
+    uint64_t allocs;
+} stats_t;
+
+// the counters are shared by all lua_States in the process, and may be
+// updated from multiple threads. they are updated by the relaxed atomic
+// operations, since they are not used to synchronize anything.
+static stats_t STATS[STATS_MAX];
+
+# define stats_add(v, n)   __atomic_fetch_add(&(v), (n), __ATOMIC_RELAXED)
+# define stats_load(v)     __atomic_load_n(&(v), __ATOMIC_RELAXED)
+# define stats_store(v, n) __atomic_store_n(&(v), (n), __ATOMIC_RELAXED)
+# define stats_update(id, nin, nout)                                           \
+    do {                                                                       \
+        stats_add(STATS[id].calls, 1);                                         \
+        stats_add(STATS[id].bytes_in, (uint64_t)(nin));                        \
+        stats_add(STATS[id].bytes_out, (uint64_t)(nout));                      \
+    } while (0)
+# define stats_error(id)                                                       \
     do {                                                                       \
+        stats_add(STATS[id].calls, 1);                                         \
+        stats_add(STATS[id].errors, 1);                                        \
+    } while (0)
+# define stats_alloc(id) stats_add(STATS[id].allocs, 1)
+#endif
+
+#define BASE64MIX_POOL_MT "base64mix.pool"
+
+// registry key of the thread pool
+static const char POOL_KEY = 0;
+
+static int pool_gc_lua(lua_State *L)
+{
+    b64m_pool_destroy(lua_touserdata(L, 1));
+    return 0;
+}
+
+/**
+ * getpool returns the thread pool of the lua_State. the pool is created on
+ * first use, and destroyed when the lua_State is closed.
+ * it returns NULL if the pool cannot be created.
+ */
+static b64m_pool_t *getpool(lua_State *L)
+{
+    b64m_pool_t *pool = NULL;
+
+    lua_pushlightuserdata(L, (void *)&POOL_KEY);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    pool = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if (pool) {
+        return pool;
+    }
+
+    pool = lua_newuserdata(L, sizeof(b64m_pool_t));
+    if (b64m_pool_init(pool) != 0) {
+        lua_pop(L, 1);
+        return NULL;
+    }
+    luaL_getmetatable(L, BASE64MIX_POOL_MT);
+    lua_setmetatable(L, -2);
+    lua_pushlightuserdata(L, (void *)&POOL_KEY);
+    lua_insert(L, -2);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+    return pool;
+}
+
+/**
+ * checkthreads returns the number of threads specified by the threads field
+ * of the option table at idx.
+ */
+static int checkthreads(lua_State *L, int idx)
+{
+    lua_Integer n = 1;
+
+    if (lua_isnoneornil(L, idx)) {
+        return 1;
+    }
+    luaL_checktype(L, idx, LUA_TTABLE);
+    lua_getfield(L, idx, "threads");
+    if (!lua_isnil(L, -1)) {
+        if (lua_type(L, -1) != LUA_TNUMBER) {
+            luaL_argerror(L, idx, "threads must be integer");
+        }
+        n = lua_tointeger(L, -1);
+        luaL_argcheck(L, n > 0, idx, "threads must be greater than 0");
+    }
+    lua_pop(L, 1);
+    return n > B64M_POOL_MAX + 1 ? B64M_POOL_MAX + 1 : (int)n;
+}
+
+/**
+ * subrange converts the i and j indexes of the string of l bytes in the same
+ * way as string.sub(), and returns the offset of the substring and stores
+ * its length into len.
+ */
+static size_t subrange(lua_Integer l, lua_Integer i, lua_Integer j,
+                       size_t *len)
+{
+    // convert the negative indexes
+    if (i < 0) {
+        i = (i < -l) ? 1 : l + i + 1;
+    } else if (i == 0) {
+        i = 1;
+    }
+    if (j < 0) {
+        j = l + j + 1;
+    } else if (j > l) {
+        j = l;
+    }
+
+    if (i > j) {
+        *len = 0;
+        return 0;
+    }
+    *len = (size_t)(j - i + 1);
+    return (size_t)(i - 1);
+}
+
+/**
+ * checksubstr returns the substring of the string at sidx that is specified
+ * by the optional i and j arguments in the same way as string.sub(), and
+ * stores its length into len. idx is set to the index of the argument that
+ * follows them.
+ */
+static const char *checksubstr(lua_State *L, int sidx, size_t *len, int *idx)
+{
+    const char *str = luaL_checklstring(L, sidx, len);
+    lua_Integer i   = 1;
+    lua_Integer j   = -1;
+
+    *idx = sidx + 1;
+    if (lua_type(L, *idx) == LUA_TNUMBER) {
+        i = luaL_checkinteger(L, (*idx)++);
+        // j can be nil to pass the following arguments
+        if (lua_isnoneornil(L, *idx) || lua_type(L, *idx) == LUA_TNUMBER) {
+            j = luaL_optinteger(L, (*idx)++, -1);
+        }
+    }
+
+    return str + subrange((lua_Integer)*len, i, j, len);
+}
+
+#define BASE64MIX_BUFFER_MT "base64mix.buffer"
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    // allocator of the lua_State that created the buffer
+    lua_Alloc allocf;
+    void *ud;
+} buffer_t;
+
+/**
+ * buffer_reserve grows the buffer to store at least bytes, and returns the
+ * data pointer. the capacity is grown geometrically so that the repeated
+ * use of the same buffer does not reallocate in steady state.
+ * it returns NULL and sets ENOMEM to errno if the allocation fails.
+ */
+static char *buffer_reserve(buffer_t *buf, size_t bytes)
+{
+    if (bytes > buf->cap || !buf->data) {
+        size_t cap = (bytes > buf->cap * 2) ? bytes : buf->cap * 2;
+        char *data = NULL;
+
+        if (cap < LUAL_BUFFERSIZE) {
+            cap = LUAL_BUFFERSIZE;
+        }
+        if (!(data = buf->allocf(buf->ud, buf->data, buf->cap, cap))) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        buf->data = data;
+        buf->cap  = cap;
+    }
+    return buf->data;
+}
+
+/**
+ * tobuffer returns the buffer at idx, or returns NULL if the value at idx is
+ * not a userdata.
+ */
+static buffer_t *tobuffer(lua_State *L, int idx)
+{
+    if (lua_type(L, idx) != LUA_TUSERDATA) {
+        return NULL;
+    }
+    return luaL_checkudata(L, idx, BASE64MIX_BUFFER_MT);
+}
+
+/**
+ * scratch blocks
+ *
+ * the results that do not fit into the buffer of luaL_Buffer are written
+ * into a scratch block, and then copied into a new string. the blocks are
+ * allocated by the allocator of the lua_State, and kept in the free lists of
+ * the size classes of SCRATCH_MIN_SIZE * 4^n bytes, so that the repeated
+ * calls do not allocate a temporary buffer every time.
+ * a block is marked busy while it is used, since the finalizers that run
+ * during the allocation of the result string may call the module functions.
+ * if an error is raised while a block is busy, it is not reused until the
+ * lua_State is closed.
+ */
+#define BASE64MIX_SCRATCH_MT "base64mix.scratch"
+#define SCRATCH_MIN_SHIFT    12
+#define SCRATCH_NCLASS       3
+#define SCRATCH_NBLOCK       2
+#define SCRATCH_SIZE(c)      ((size_t)1 << (SCRATCH_MIN_SHIFT + (c) * 2))
+
+typedef struct {
+    char *data;
+    int busy;
+} scratch_block_t;
+
+typedef struct {
+    lua_Alloc allocf;
+    void *ud;
+    scratch_block_t blocks[SCRATCH_NCLASS][SCRATCH_NBLOCK];
+} scratch_t;
+
+// registry key of the scratch blocks
+static const char SCRATCH_KEY = 0;
+
+static int scratch_gc_lua(lua_State *L)
+{
+    scratch_t *s = lua_touserdata(L, 1);
+    int c        = 0;
+
+    for (; c < SCRATCH_NCLASS; c++) {
+        int i = 0;
+
+        for (; i < SCRATCH_NBLOCK; i++) {
+            if (s->blocks[c][i].data) {
+                s->allocf(s->ud, s->blocks[c][i].data, SCRATCH_SIZE(c), 0);
+                s->blocks[c][i].data = NULL;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * getscratch returns the scratch blocks of the lua_State. they are created
+ * on first use, and freed when the lua_State is closed.
+ */
+static scratch_t *getscratch(lua_State *L)
+{
+    scratch_t *s = NULL;
+
+    lua_pushlightuserdata(L, (void *)&SCRATCH_KEY);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    s = lua_touserdata(L, -1);
+    lua_pop(L, 1);
+    if (s) {
+        return s;
+    }
+
+    s  = lua_newuserdata(L, sizeof(scratch_t));
+    *s = (scratch_t){0};
+    s->allocf = lua_getallocf(L, &s->ud);
+    luaL_getmetatable(L, BASE64MIX_SCRATCH_MT);
+    lua_setmetatable(L, -2);
+    lua_pushlightuserdata(L, (void *)&SCRATCH_KEY);
+    lua_insert(L, -2);
+    lua_rawset(L, LUA_REGISTRYINDEX);
+    return s;
+}
+
+/**
+ * scratch_acquire returns a free scratch block of at least bytes, or returns
+ * NULL if bytes exceeds the largest size class or no block is available.
+ * the size of the block is stored into cap.
+ */
+static scratch_block_t *scratch_acquire(lua_State *L, size_t bytes,
+                                        size_t *cap)
+{
+    scratch_t *s = NULL;
+    int c        = 0;
+    int i        = 0;
+
+    if (bytes > SCRATCH_SIZE(SCRATCH_NCLASS - 1)) {
+        return NULL;
+    }
+    while (SCRATCH_SIZE(c) < bytes) {
+        c++;
+    }
+    s = getscratch(L);
+    for (; i < SCRATCH_NBLOCK; i++) {
+        scratch_block_t *blk = &s->blocks[c][i];
+
+        if (blk->busy) {
+            continue;
+        } else if (!blk->data &&
+                   !(blk->data = s->allocf(s->ud, NULL, 0, SCRATCH_SIZE(c)))) {
+            return NULL;
+        }
+        blk->busy = 1;
+        *cap      = SCRATCH_SIZE(c);
+        return blk;
+    }
+    return NULL;
+}
+
+static inline void scratch_release(scratch_block_t *blk)
+{
+    if (blk) {
+        blk->busy = 0;
+    }
+}
+
+/**
+ * scratch_reserve returns the temporary space of at least bytes. buf and cap
+ * are the current space, and blk is its scratch block. if the space is too
+ * small, it is replaced by a larger scratch block, or by a userdata that is
+ * stored at idx if no scratch block is available. the allocation of the
+ * userdata is counted in the counters of id.
+ */
+static char *scratch_reserve(lua_State *L, int id, int idx,
+                             scratch_block_t **blk, char *buf, size_t *cap,
+                             size_t bytes)
+{
+    if (buf && bytes <= *cap) {
+        return buf;
+    }
+    // grow geometrically
+    *cap = (bytes > *cap * 2) ? bytes : *cap * 2;
+    if (*cap < LUAL_BUFFERSIZE) {
+        *cap = LUAL_BUFFERSIZE;
+    }
+    scratch_release(*blk);
+    if ((*blk = scratch_acquire(L, *cap, cap))) {
+        return (*blk)->data;
+    }
+    buf = lua_newuserdata(L, *cap);
+    lua_replace(L, idx);
+    stats_alloc(id);
+    return buf;
+}
+
+/**
+ * zero-copy results
+ *
+ * if the zerocopy option is specified, the results of at least that many
+ * bytes are written directly into the memory that is handed to Lua without
+ * copying. on Lua 5.5, the memory is allocated by the allocator of the
+ * lua_State and pushed as an external string. on the older versions, the
+ * result is written into a read-only view userdata that stands in for the
+ * string.
+ */
+#define BASE64MIX_VIEW_MT "base64mix.view"
+
+typedef struct {
+    size_t len;
+    char data[];
+} view_t;
+
+static int view_len_lua(lua_State *L)
+{
+    view_t *view = luaL_checkudata(L, 1, BASE64MIX_VIEW_MT);
+
+    lua_pushinteger(L, (lua_Integer)view->len);
+    return 1;
+}
+
+static int view_tostring_lua(lua_State *L)
+{
+    view_t *view = luaL_checkudata(L, 1, BASE64MIX_VIEW_MT);
+
+    lua_pushlstring(L, view->data, view->len);
+    return 1;
+}
+
+static int view_sub_lua(lua_State *L)
+{
+    view_t *view  = luaL_checkudata(L, 1, BASE64MIX_VIEW_MT);
+    lua_Integer i = luaL_checkinteger(L, 2);
+    lua_Integer j = luaL_optinteger(L, 3, -1);
+    size_t len    = 0;
+    size_t offset = subrange((lua_Integer)view->len, i, j, &len);
+
+    lua_pushlstring(L, view->data + offset, len);
+    return 1;
+}
+
+/**
+ * result_t is the destination of the result. the result is stored into buf
+ * if it is not NULL, into the zero-copy memory ext or the view if the result
+ * is at least zerocopy bytes, into the scratch block blk if it is acquired,
+ * or into the luaL_Buffer b otherwise.
+ */
+typedef struct {
+    buffer_t *buf;
+    size_t zerocopy;
+#if LUA_VERSION_NUM >= 505
+    char *ext;
+    size_t extcap;
+#else
+    view_t *view;
+#endif
+    scratch_block_t *blk;
+    luaL_Buffer b;
+} result_t;
+
+/**
+ * prepresult returns the space of bytes to store the result into. the
+ * allocation is counted in the counters of id.
+ * it returns NULL if the space cannot be allocated.
+ */
+static char *prepresult(lua_State *L, int id, result_t *r, size_t bytes)
+{
+    size_t cap = 0;
+
+    if (r->buf) {
+        char *data = NULL;
+
+        cap         = r->buf->cap;
+        data        = buffer_reserve(r->buf, bytes);
+        r->buf->len = 0;
+        if (r->buf->cap != cap) {
+            stats_alloc(id);
+        }
+        return data;
+    }
+    // the result is pushed as a new string
+    stats_alloc(id);
+    if (r->zerocopy && bytes >= r->zerocopy) {
+#if LUA_VERSION_NUM >= 505
+        void *ud        = NULL;
+        lua_Alloc alloc = lua_getallocf(L, &ud);
+
+        // external strings must be null-terminated
+        if (bytes == SIZE_MAX || !(r->ext = alloc(ud, NULL, 0, bytes + 1))) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        r->extcap = bytes + 1;
+        return r->ext;
+#else
+        r->view = lua_newuserdata(L, sizeof(view_t) + bytes);
+        luaL_getmetatable(L, BASE64MIX_VIEW_MT);
+        lua_setmetatable(L, -2);
+        r->view->len = 0;
+        return r->view->data;
+#endif
+    }
+    if (bytes > LUAL_BUFFERSIZE && (r->blk = scratch_acquire(L, bytes, &cap))) {
+        return r->blk->data;
+    }
+    return luaL_buffinitsize(L, &r->b, bytes);
+}
+
+/**
+ * pushresult pushes the result of len bytes. if buf is not NULL, the buffer
+ * at idx is pushed instead of a new string.
+ */
+static void pushresult(lua_State *L, result_t *r, int idx, size_t len)
+{
+    if (r->buf) {
+        r->buf->len = len;
+        lua_pushvalue(L, idx);
+        return;
+    }
+#if LUA_VERSION_NUM >= 505
+    else if (r->ext) {
+        void *ud        = NULL;
+        lua_Alloc alloc = lua_getallocf(L, &ud);
+        char *ext       = NULL;
+
+        // shrink to the actual size that is freed by lua
+        if (len + 1 != r->extcap &&
+            !(ext = alloc(ud, r->ext, r->extcap, len + 1))) {
+            // lua would free the block with the wrong size, so copy it into
+            // a new string and free the block with its real size
+            ext    = r->ext;
+            r->ext = NULL;
+            lua_pushlstring(L, ext, len);
+            alloc(ud, ext, r->extcap, 0);
+            return;
+        } else if (ext) {
+            r->ext = ext;
+        }
+        r->ext[len] = 0;
+        lua_pushexternalstring(L, r->ext, len, alloc, ud);
+        r->ext = NULL;
+        return;
+    }
+#else
+    else if (r->view) {
+        // the view is at the top of the stack
+        r->view->len = len;
+        return;
+    }
+#endif
+    else if (r->blk) {
+        lua_pushlstring(L, r->blk->data, len);
+        scratch_release(r->blk);
+        return;
+    }
+    luaL_pushresultsize(&r->b, len);
+}
+
+/**
+ * discardresult releases the space of the result that is not pushed.
+ */
+static void discardresult(lua_State *L, result_t *r)
+{
+#if LUA_VERSION_NUM >= 505
+    if (r->ext) {
+        void *ud        = NULL;
+        lua_Alloc alloc = lua_getallocf(L, &ud);
+
+        alloc(ud, r->ext, r->extcap, 0);
+        r->ext = NULL;
+    }
+#else
+    (void)L;
+#endif
+    scratch_release(r->blk);
+}
+
+/**
+ * checkzerocopy returns the threshold of the zero-copy results, specified by
+ * the zerocopy field of the option table at idx. it returns 0 if the field
+ * is not specified.
+ */
+static size_t checkzerocopy(lua_State *L, int idx)
+{
+    lua_Integer n = 0;
+
+    if (lua_type(L, idx) != LUA_TTABLE) {
+        return 0;
+    }
+    lua_getfield(L, idx, "zerocopy");
+    if (!lua_isnil(L, -1)) {
+        if (lua_type(L, -1) != LUA_TNUMBER) {
+            luaL_argerror(L, idx, "zerocopy must be integer");
+        }
+        n = lua_tointeger(L, -1);
+        luaL_argcheck(L, n > 0, idx, "zerocopy must be greater than 0");
+    }
+    lua_pop(L, 1);
+    return (size_t)n;
+}
+
+/**
+ * checkpad returns whether the padding characters are appended, specified
+ * by the pad field of the option table at idx. it returns def if the field
+ * is not specified.
+ */
+static int checkpad(lua_State *L, int idx, int def)
+{
+    int pad = def;
+
+    if (lua_type(L, idx) != LUA_TTABLE) {
+        return def;
+    }
+    lua_getfield(L, idx, "pad");
+    if (!lua_isnil(L, -1)) {
+        if (lua_type(L, -1) != LUA_TBOOLEAN) {
+            luaL_argerror(L, idx, "pad must be boolean");
+        }
+        pad = lua_toboolean(L, -1);
+    }
+    lua_pop(L, 1);
+    return pad;
+}
+
+#define encode_lua(L, id, enctbl, defpad)                                      \
+    do {                                                                       \
+        int idx           = 0;                                                 \
+        size_t len        = 0;                                                 \
+        const char *str   = checksubstr(L, 1, &len, &idx);                     \
+        result_t r        = {.buf = tobuffer(L, idx)};                         \
+        int optidx        = r.buf ? idx + 1 : idx;                             \
+        int nthread       = checkthreads(L, optidx);                           \
+        int pad           = checkpad(L, optidx, defpad);                       \
+        size_t bytes      = b64m_encoded_len(len, pad);                        \
+        b64m_pool_t *pool = NULL;                                              \
+        char *b64         = NULL;                                              \
+        if (bytes == SIZE_MAX) {                                               \
+            stats_error(id);                                                   \
+            lua_pushnil(L);                                                    \
+            lua_pushstring(L, strerror(errno));                                \
+            return 2;                                                          \
+        }                                                                      \
+        /* the pool must be created before the buffer uses the stack */        \
+        pool       = (nthread > 1) ? getpool(L) : NULL;                        \
+        r.zerocopy = checkzerocopy(L, optidx);                                 \
+        if (!(b64 = prepresult(L, id, &r, bytes))) {                           \
+            stats_error(id);                                                   \
+            lua_pushnil(L);                                                    \
+            lua_pushstring(L, strerror(errno));                                \
+            return 2;                                                          \
+        } else if (pool) {                                                     \
+            bytes = b64m_pool_encode(pool, nthread, (unsigned char *)b64,      \
+                                     (unsigned char *)str, len, enctbl, pad);  \
+        } else {                                                               \
+            bytes = b64m_encode_pad_raw((unsigned char *)b64,                  \
+                                        (unsigned char *)str, len, enctbl,     \
+                                        pad);                                  \
+        }                                                                      \
+        stats_update(id, len, bytes);                                          \
+        pushresult(L, &r, idx, bytes);                                         \
+        return 1;                                                              \
+    } while (0)
+
+static int encode_std_lua(lua_State *L)
+{
+    encode_lua(L, STATS_ENCODE, BASE64MIX_STDENC, 1);
+}
+
+static int encode_url_lua(lua_State *L)
+{
+    encode_lua(L, STATS_ENCODE_URL, BASE64MIX_URLENC, 0);
+}
+
+/**
+ * encode_to_lua appends the encoded string to the contents of the buffer at
+ * index 1, so that the string can be built without the intermediate encoded
+ * string.
+ */
+#define encode_to_lua(L, id, enctbl, defpad)                                   \
+    do {                                                                       \
+        buffer_t *buf   = luaL_checkudata(L, 1, BASE64MIX_BUFFER_MT);          \
+        int idx         = 0;                                                   \
         size_t len      = 0;                                                   \
-        const char *str = luaL_checklstring(L, 1, &len);                       \
-        char *b64       = fn((unsigned char *)str, &len);                      \
-        if (b64) {                                                             \
-            lua_pushlstring(L, b64, len);                                      \
-            free((void *)b64);                                                 \
+        const char *str = checksubstr(L, 2, &len, &idx);                       \
+        int pad         = checkpad(L, idx, defpad);                            \
+        size_t bytes    = b64m_encoded_len(len, pad);                          \
+        size_t cap      = buf->cap;                                            \
+        if (bytes == SIZE_MAX || bytes > SIZE_MAX - buf->len) {                \
+            errno = ERANGE;                                                    \
+        } else if (buffer_reserve(buf, buf->len + bytes)) {                    \
+            if (buf->cap != cap) {                                             \
+                stats_alloc(id);                                               \
+            }                                                                  \
+            bytes = b64m_encode_pad_raw((unsigned char *)buf->data + buf->len, \
+                                        (unsigned char *)str, len, enctbl,     \
+                                        pad);                                  \
+            buf->len += bytes;                                                 \
+            stats_update(id, len, bytes);                                      \
+            lua_settop(L, 1);                                                  \
             return 1;                                                          \
         }                                                                      \
+        stats_error(id);                                                       \
         lua_pushnil(L);                                                        \
         lua_pushstring(L, strerror(errno));                                    \
         return 2;                                                              \
     } while (0)
 
-static int encode_std_lua(lua_State *L)
+static int encode_to_std_lua(lua_State *L)
 {
-    encode_lua(L, b64m_encode_std);
+    encode_to_lua(L, STATS_ENCODE_TO, BASE64MIX_STDENC, 1);
 }
 
-static int encode_url_lua(lua_State *L)
+static int encode_to_url_lua(lua_State *L)
 {
-    encode_lua(L, b64m_encode_url);
+    encode_to_lua(L, STATS_ENCODE_URL_TO, BASE64MIX_URLENC, 0);
 }
 
-#define decode_lua(L, fn)                                                      \
+#define decode_lua(L, id, dectbl)                                              \
     do {                                                                       \
-        size_t len      = 0;                                                   \
-        const char *b64 = luaL_checklstring(L, 1, &len);                       \
-        char *str       = fn((unsigned char *)b64, &len);                      \
-        if (str) {                                                             \
-            lua_pushlstring(L, str, len);                                      \
-            free((void *)str);                                                 \
+        int idx           = 0;                                                 \
+        size_t len        = 0;                                                 \
+        const char *b64   = checksubstr(L, 1, &len, &idx);                     \
+        size_t bytes      = b64m_decoded_len((unsigned char *)b64, len);       \
+        result_t r        = {.buf = tobuffer(L, idx)};                         \
+        int optidx        = r.buf ? idx + 1 : idx;                             \
+        int nthread       = checkthreads(L, optidx);                           \
+        /* the pool must be created before the buffer uses the stack */        \
+        b64m_pool_t *pool = (nthread > 1) ? getpool(L) : NULL;                 \
+        char *str         = NULL;                                              \
+        ssize_t n         = -1;                                                \
+        r.zerocopy        = checkzerocopy(L, optidx);                          \
+        str               = prepresult(L, id, &r, bytes);                      \
+        if (str && pool) {                                                     \
+            n = (ssize_t)b64m_pool_decode(pool, nthread, (unsigned char *)str, \
+                                          (unsigned char *)b64, len, dectbl);  \
+        } else if (str) {                                                      \
+            n = b64m_decode_into((unsigned char *)str, bytes,                  \
+                                 (unsigned char *)b64, len, dectbl);           \
+        }                                                                      \
+        if (n != -1) {                                                         \
+            stats_update(id, len, n);                                          \
+            pushresult(L, &r, idx, n);                                         \
             return 1;                                                          \
         }                                                                      \
+        discardresult(L, &r);                                                  \
+        stats_error(id);                                                       \
         lua_pushnil(L);                                                        \
         lua_pushstring(L, strerror(errno));                                    \
         return 2;                                                              \
@@ -84,27 +825,1372 @@ static int encode_url_lua(lua_State *L)
 
 static int decode_std_lua(lua_State *L)
 {
-    decode_lua(L, b64m_decode_std);
+    decode_lua(L, STATS_DECODE, BASE64MIX_STDDEC);
 }
 
 static int decode_url_lua(lua_State *L)
 {
-    decode_lua(L, b64m_decode_url);
+    decode_lua(L, STATS_DECODE_URL, BASE64MIX_URLDEC);
 }
 
 static int decode_mix_lua(lua_State *L)
 {
-    decode_lua(L, b64m_decode_mix);
+    decode_lua(L, STATS_DECODE_MIX, BASE64MIX_DEC);
+}
+
+/**
+ * decode cache
+ *
+ * the results of decodeCached are kept in the bounded cache of each
+ * alphabet in the registry. each cache is the table of
+ * {current, previous, count}; the entries are inserted into the current
+ * table, and when it has reached CACHE_MAX entries, it becomes the previous
+ * table and the oldest one is discarded. an entry found in the previous
+ * table is moved into the current table, so that the frequently used
+ * entries survive, in the same way as an LRU of at most CACHE_MAX * 2
+ * entries. the strings longer than CACHE_MAXLEN are not cached.
+ */
+#define CACHE_MAX    256
+#define CACHE_MAXLEN 512
+
+// registry key of the decode caches
+static const char CACHE_KEY = 0;
+
+/**
+ * getcache pushes the cache of the nth alphabet onto the stack.
+ */
+static void getcache(lua_State *L, int n)
+{
+    lua_pushlightuserdata(L, (void *)&CACHE_KEY);
+    lua_rawget(L, LUA_REGISTRYINDEX);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_createtable(L, 3, 0);
+        lua_pushlightuserdata(L, (void *)&CACHE_KEY);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, LUA_REGISTRYINDEX);
+    }
+    lua_rawgeti(L, -1, n);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_createtable(L, 3, 0);
+        lua_createtable(L, 0, CACHE_MAX);
+        lua_rawseti(L, -2, 1);
+        lua_newtable(L);
+        lua_rawseti(L, -2, 2);
+        lua_pushinteger(L, 0);
+        lua_rawseti(L, -2, 3);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, -3, n);
+    }
+    lua_remove(L, -2);
+}
+
+static int decode_cached_lua(lua_State *L)
+{
+    static const char *const alphabets[] = {"std", "url", "mix", NULL};
+    static const unsigned char *const tbls[] = {
+        BASE64MIX_STDDEC,
+        BASE64MIX_URLDEC,
+        BASE64MIX_DEC,
+    };
+    size_t len      = 0;
+    const char *b64 = luaL_checklstring(L, 1, &len);
+    int a           = luaL_checkoption(L, 2, "std", alphabets);
+    lua_Integer n   = 0;
+    size_t bytes    = 0;
+    result_t r      = {0};
+    char *str       = NULL;
+    ssize_t rv      = 0;
+
+    lua_settop(L, 1);
+    if (len <= CACHE_MAXLEN) {
+        getcache(L, a + 1);   // 2: cache
+        lua_rawgeti(L, 2, 1); // 3: current
+        lua_pushvalue(L, 1);
+        lua_rawget(L, 3);
+        if (!lua_isnil(L, -1)) {
+            stats_update(STATS_DECODE_CACHED, len, lua_rawlen(L, -1));
+            return 1;
+        }
+        lua_pop(L, 1);
+        lua_rawgeti(L, 2, 2); // 4: previous
+        lua_pushvalue(L, 1);
+        lua_rawget(L, 4);
+        if (!lua_isnil(L, -1)) {
+            stats_update(STATS_DECODE_CACHED, len, lua_rawlen(L, -1));
+            goto INSERT;
+        }
+        lua_pop(L, 1);
+    }
+
+    bytes = b64m_decoded_len((unsigned char *)b64, len);
+    str   = prepresult(L, STATS_DECODE_CACHED, &r, bytes);
+    rv    = b64m_decode_into((unsigned char *)str, bytes,
+                             (unsigned char *)b64, len, tbls[a]);
+    if (rv == -1) {
+        discardresult(L, &r);
+        stats_error(STATS_DECODE_CACHED);
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+    stats_update(STATS_DECODE_CACHED, len, rv);
+    pushresult(L, &r, 0, rv);
+    if (len > CACHE_MAXLEN) {
+        return 1;
+    }
+
+INSERT:
+    // the result is at the top of the stack
+    lua_rawgeti(L, 2, 3);
+    n = lua_tointeger(L, -1);
+    lua_pop(L, 1);
+    if (n >= CACHE_MAX) {
+        // discard the previous table
+        lua_pushvalue(L, 3);
+        lua_rawseti(L, 2, 2);
+        lua_createtable(L, 0, CACHE_MAX);
+        lua_pushvalue(L, -1);
+        lua_rawseti(L, 2, 1);
+        lua_replace(L, 3);
+        n = 0;
+    }
+    lua_pushvalue(L, 1);
+    lua_pushvalue(L, -2);
+    lua_rawset(L, 3);
+    lua_pushinteger(L, n + 1);
+    lua_rawseti(L, 2, 3);
+    return 1;
+}
+
+#define transcode_lua(L, id, dectbl, enctbl, pad)                              \
+    do {                                                                       \
+        size_t len      = 0;                                                   \
+        const char *src = luaL_checklstring(L, 1, &len);                       \
+        size_t bytes    = 0;                                                   \
+        result_t r      = {0};                                                 \
+        char *dst       = NULL;                                                \
+        lua_settop(L, 1);                                                      \
+        bytes = b64m_transcoded_len((unsigned char *)src, len, pad);           \
+        dst   = prepresult(L, id, &r, bytes);                                  \
+        bytes = b64m_transcode_raw((unsigned char *)dst, (unsigned char *)src, \
+                                   len, dectbl, enctbl, pad);                  \
+        if (bytes != SIZE_MAX) {                                               \
+            stats_update(id, len, bytes);                                      \
+            pushresult(L, &r, 0, bytes);                                       \
+            return 1;                                                          \
+        }                                                                      \
+        discardresult(L, &r);                                                  \
+        stats_error(id);                                                       \
+        lua_pushnil(L);                                                        \
+        lua_pushstring(L, strerror(errno));                                    \
+        return 2;                                                              \
+    } while (0)
+
+static int to_url_lua(lua_State *L)
+{
+    int pad = lua_toboolean(L, 2);
+
+    transcode_lua(L, STATS_TO_URL, BASE64MIX_STDDEC, BASE64MIX_URLENC, pad);
+}
+
+static int to_std_lua(lua_State *L)
+{
+    transcode_lua(L, STATS_TO_STD, BASE64MIX_URLDEC, BASE64MIX_STDENC, 1);
+}
+
+/**
+ * findsep returns the first occurrence of sep of slen bytes in the range of
+ * str to end, or returns end if not found.
+ */
+static const char *findsep(const char *str, const char *end, const char *sep,
+                           size_t slen)
+{
+    while ((str = memchr(str, *sep, end - str))) {
+        if ((size_t)(end - str) < slen) {
+            break;
+        } else if (memcmp(str, sep, slen) == 0) {
+            return str;
+        }
+        str++;
+    }
+    return end;
+}
+
+static int decode_segments_lua(lua_State *L)
+{
+    static const char *const alphabets[] = {"url", "mix", "std", NULL};
+    static const unsigned char *const tbls[] = {
+        BASE64MIX_URLDEC,
+        BASE64MIX_DEC,
+        BASE64MIX_STDDEC,
+    };
+    size_t len                  = 0;
+    const char *str             = luaL_checklstring(L, 1, &len);
+    size_t slen                 = 0;
+    const char *sep             = luaL_checklstring(L, 2, &slen);
+    int a                       = luaL_checkoption(L, 3, "url", alphabets);
+    const unsigned char *dectbl = tbls[a];
+    const char *end             = str + len;
+    scratch_block_t *blk        = NULL;
+    char *buf                   = NULL;
+    size_t cap                  = 0;
+    int nseg                    = 0;
+
+    luaL_argcheck(L, slen > 0, 2, "sep must not be empty");
+    lua_settop(L, 3);
+    lua_pushnil(L); // 4: scratch buffer
+
+    // decode all segments through one scratch buffer
+    for (;;) {
+        const char *seg = str;
+        size_t bytes    = 0;
+        ssize_t rv      = 0;
+
+        str   = findsep(seg, end, sep, slen);
+        bytes = b64m_decoded_len((unsigned char *)seg, str - seg);
+        buf   = scratch_reserve(L, STATS_DECODE_SEGMENTS, 4, &blk, buf, &cap,
+                                bytes);
+        rv    = b64m_decode_into((unsigned char *)buf, cap,
+                                 (unsigned char *)seg, str - seg, dectbl);
+        if (rv == -1) {
+            scratch_release(blk);
+            stats_error(STATS_DECODE_SEGMENTS);
+            lua_pushnil(L);
+            lua_pushstring(L, strerror(errno));
+            return 2;
+        } else if (!lua_checkstack(L, 2)) {
+            scratch_release(blk);
+            return luaL_error(L, "too many segments");
+        }
+        stats_update(STATS_DECODE_SEGMENTS, str - seg, rv);
+        stats_alloc(STATS_DECODE_SEGMENTS);
+        lua_pushlstring(L, buf, rv);
+        nseg++;
+        if (str == end) {
+            break;
+        }
+        str += slen;
+    }
+    scratch_release(blk);
+
+    return nseg;
+}
+
+static int encode_mime_lua(lua_State *L)
+{
+    size_t len      = 0;
+    const char *str = luaL_checklstring(L, 1, &len);
+    lua_Integer ll  = luaL_optinteger(L, 2, 76);
+    size_t eollen   = 0;
+    const char *eol = luaL_optlstring(L, 3, "\r\n", &eollen);
+    size_t bytes    = 0;
+    luaL_Buffer b;
+    char *b64 = NULL;
+
+    luaL_argcheck(L, ll > 0 && ll % 4 == 0, 2,
+                  "linelen must be a positive multiple of 4");
+    bytes = b64m_encoded_mime_len(len, 1, (size_t)ll, eollen);
+    if (bytes == SIZE_MAX) {
+        stats_error(STATS_ENCODE_MIME);
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+    stats_alloc(STATS_ENCODE_MIME);
+    b64   = luaL_buffinitsize(L, &b, bytes);
+    bytes = b64m_encode_mime_raw((unsigned char *)b64, (unsigned char *)str,
+                                 len, BASE64MIX_STDENC, (size_t)ll,
+                                 (unsigned char *)eol, eollen);
+    stats_update(STATS_ENCODE_MIME, len, bytes);
+    luaL_pushresultsize(&b, bytes);
+    return 1;
+}
+
+static int decode_mime_lua(lua_State *L)
+{
+    size_t len      = 0;
+    const char *b64 = luaL_checklstring(L, 1, &len);
+    size_t bytes    = b64m_decoded_len((unsigned char *)b64, len);
+    luaL_Buffer b;
+    char *str = luaL_buffinitsize(L, &b, bytes);
+
+    stats_alloc(STATS_DECODE_MIME);
+    bytes = b64m_decode_ws_raw((unsigned char *)str, (unsigned char *)b64, len,
+                               BASE64MIX_STDDEC);
+    if (bytes != SIZE_MAX) {
+        stats_update(STATS_DECODE_MIME, len, bytes);
+        luaL_pushresultsize(&b, bytes);
+        return 1;
+    }
+    stats_error(STATS_DECODE_MIME);
+    lua_pushnil(L);
+    lua_pushstring(L, strerror(errno));
+    return 2;
+}
+
+/**
+ * batch_lua encodes or decodes all strings in the array table at index 1
+ * through one scratch buffer, and returns a result table and an error
+ * table. if an element cannot be processed, its result is false and its
+ * error message is stored in the error table at the same index. the error
+ * table is nil if all elements are processed.
+ */
+static int batch_lua(lua_State *L, int id, const unsigned char *tbl,
+                     int decode, int pad)
+{
+    size_t n   = 0;
+    size_t i   = 1;
+    size_t cap           = 0;
+    char *buf            = NULL;
+    scratch_block_t *blk = NULL;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    n = lua_rawlen(L, 1);
+    lua_settop(L, 1);
+    lua_createtable(L, (int)n, 0); // 2: results
+    lua_pushnil(L);                // 3: errors
+    lua_pushnil(L);                // 4: scratch buffer
+
+    for (; i <= n; i++) {
+        size_t len      = 0;
+        const char *src = NULL;
+        size_t bytes    = 0;
+        ssize_t rv      = 0;
+
+        lua_rawgeti(L, 1, (int)i);
+        if (lua_type(L, -1) != LUA_TSTRING) {
+            lua_pushfstring(L, "string expected, got %s",
+                            luaL_typename(L, -1));
+            goto FAIL;
+        }
+        src   = lua_tolstring(L, -1, &len);
+        bytes = decode ? b64m_decoded_len((unsigned char *)src, len) :
+                         b64m_encoded_len(len, pad);
+        if (bytes == SIZE_MAX) {
+            lua_pushstring(L, strerror(errno));
+            goto FAIL;
+        }
+        buf = scratch_reserve(L, id, 4, &blk, buf, &cap, bytes);
+
+        rv = decode ? b64m_decode_into((unsigned char *)buf, cap,
+                                       (unsigned char *)src, len, tbl) :
+                      b64m_encode_into((unsigned char *)buf, cap,
+                                       (unsigned char *)src, len, tbl);
+        if (rv == -1) {
+            lua_pushstring(L, strerror(errno));
+            goto FAIL;
+        }
+        stats_update(id, len, rv);
+        stats_alloc(id);
+        lua_pushlstring(L, buf, rv);
+        lua_rawseti(L, 2, (int)i);
+        lua_pop(L, 1);
+        continue;
+
+FAIL:
+        stats_error(id);
+        // errors[i] = message, results[i] = false
+        if (lua_isnil(L, 3)) {
+            lua_newtable(L);
+            lua_replace(L, 3);
+        }
+        lua_rawseti(L, 3, (int)i);
+        lua_pushboolean(L, 0);
+        lua_rawseti(L, 2, (int)i);
+        lua_pop(L, 1);
+    }
+
+    scratch_release(blk);
+    lua_settop(L, 3);
+    return 2;
+}
+
+static int encode_batch_std_lua(lua_State *L)
+{
+    return batch_lua(L, STATS_ENCODE_BATCH, BASE64MIX_STDENC, 0, 1);
+}
+
+static int encode_batch_url_lua(lua_State *L)
+{
+    return batch_lua(L, STATS_ENCODE_URL_BATCH, BASE64MIX_URLENC, 0, 0);
+}
+
+static int decode_batch_std_lua(lua_State *L)
+{
+    return batch_lua(L, STATS_DECODE_BATCH, BASE64MIX_STDDEC, 1, 0);
+}
+
+static int decode_batch_url_lua(lua_State *L)
+{
+    return batch_lua(L, STATS_DECODE_URL_BATCH, BASE64MIX_URLDEC, 1, 0);
+}
+
+static int decode_batch_mix_lua(lua_State *L)
+{
+    return batch_lua(L, STATS_DECODE_MIX_BATCH, BASE64MIX_DEC, 1, 0);
+}
+
+static const unsigned char *checkenctbl(lua_State *L, int idx)
+{
+    static const char *const alphabets[] = {"std", "url", NULL};
+    static const unsigned char *const tbls[] = {
+        BASE64MIX_STDENC,
+        BASE64MIX_URLENC,
+    };
+    return tbls[luaL_checkoption(L, idx, "std", alphabets)];
+}
+
+static const unsigned char *checkdectbl(lua_State *L, int idx)
+{
+    static const char *const alphabets[] = {"std", "url", "mix", NULL};
+    static const unsigned char *const tbls[] = {
+        BASE64MIX_STDDEC,
+        BASE64MIX_URLDEC,
+        BASE64MIX_DEC,
+    };
+    return tbls[luaL_checkoption(L, idx, "std", alphabets)];
+}
+
+static int decode_range_lua(lua_State *L)
+{
+    size_t len                  = 0;
+    const char *b64             = luaL_checklstring(L, 1, &len);
+    lua_Integer offset          = luaL_checkinteger(L, 2);
+    lua_Integer n               = luaL_checkinteger(L, 3);
+    const unsigned char *dectbl = checkdectbl(L, 4);
+    size_t total                = b64m_decoded_len((unsigned char *)b64, len);
+    result_t r                  = {0};
+    char *str                   = NULL;
+    size_t bytes                = 0;
+
+    luaL_argcheck(L, offset >= 0, 2, "offset must not be negative");
+    luaL_argcheck(L, n >= 0, 3, "length must not be negative");
+    lua_settop(L, 1);
+    // truncate the range at the end of the decoded bytes
+    if ((size_t)offset >= total) {
+        n = 0;
+    } else if ((size_t)n > total - (size_t)offset) {
+        n = (lua_Integer)(total - (size_t)offset);
+    }
+    str   = prepresult(L, STATS_DECODE_RANGE, &r, (size_t)n + 4);
+    bytes = b64m_decode_range((unsigned char *)str, (unsigned char *)b64, len,
+                              (size_t)offset, (size_t)n, dectbl);
+    if (bytes != SIZE_MAX) {
+        // count the characters of the covering groups
+        stats_update(STATS_DECODE_RANGE,
+                     bytes ? (((size_t)offset + bytes + 2) / 3 -
+                              (size_t)offset / 3) * 4 :
+                             0,
+                     bytes);
+        pushresult(L, &r, 0, bytes);
+        return 1;
+    }
+    discardresult(L, &r);
+    stats_error(STATS_DECODE_RANGE);
+    lua_pushnil(L);
+    lua_pushstring(L, strerror(errno));
+    return 2;
+}
+
+// maximum length of the binary ID such as UUID
+#define ID_MAXLEN 16
+
+static int encode_int_lua(lua_State *L)
+{
+    unsigned char b64[(ID_MAXLEN + 2) / 3 * 4];
+    size_t nin = 0;
+    size_t len = 0;
+
+    if (lua_type(L, 1) == LUA_TSTRING) {
+        // fixed-width binary ID
+        const char *id = lua_tolstring(L, 1, &nin);
+
+        luaL_argcheck(L, nin > 0 && nin <= ID_MAXLEN, 1,
+                      "string must be 1 to 16 bytes");
+        luaL_argcheck(L, lua_isnoneornil(L, 2), 2,
+                      "width cannot be specified for string");
+        len = b64m_encode_short(b64, (unsigned char *)id, nin,
+                                BASE64MIX_URLENC, 0);
+    } else {
+        lua_Integer n     = luaL_checkinteger(L, 1);
+        lua_Integer width = luaL_optinteger(L, 2, 8);
+        uint64_t v        = (uint64_t)n;
+
+        luaL_argcheck(L, width > 0 && width <= 8, 2, "width must be 1 to 8");
+        luaL_argcheck(L, width == 8 || v >> (width * 8) == 0, 1,
+                      "integer does not fit into width bytes");
+        nin = (size_t)width;
+        len = b64m_encode_uint(b64, v, nin, BASE64MIX_URLENC);
+    }
+    stats_update(STATS_ENCODE_INT, nin, len);
+    lua_pushlstring(L, (const char *)b64, len);
+    return 1;
+}
+
+// the largest integer that lua_Number can represent exactly if lua_Integer
+// is converted into lua_Number
+#define INT_EXACT_MAX ((uint64_t)1 << 53)
+
+static int decode_int_lua(lua_State *L)
+{
+    size_t len      = 0;
+    const char *b64 = luaL_checklstring(L, 1, &len);
+    int asstr       = 0;
+    size_t bytes    = b64m_decoded_len((unsigned char *)b64, len);
+    unsigned char id[ID_MAXLEN];
+    uint64_t v = 0;
+
+    if (!lua_isnoneornil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TBOOLEAN);
+        asstr = lua_toboolean(L, 2);
+    }
+
+    if (bytes > (asstr ? ID_MAXLEN : 8)) {
+        errno = ERANGE;
+    } else if (asstr) {
+        // fixed-width binary ID
+        bytes = b64m_decode_short(id, (unsigned char *)b64, len,
+                                  BASE64MIX_URLDEC);
+        if (bytes != SIZE_MAX) {
+            stats_update(STATS_DECODE_INT, len, bytes);
+            lua_pushlstring(L, (const char *)id, bytes);
+            return 1;
+        }
+    } else if ((bytes = b64m_decode_uint(&v, (unsigned char *)b64, len,
+                                         BASE64MIX_URLDEC)) == SIZE_MAX) {
+        // invalid character
+    }
+#if LUA_VERSION_NUM < 503
+    // lua_pushinteger converts the integer into lua_Number
+    else if (v > INT_EXACT_MAX) {
+        errno = ERANGE;
+    }
+#endif
+    else {
+        stats_update(STATS_DECODE_INT, len, bytes);
+        lua_pushinteger(L, (lua_Integer)v);
+        return 1;
+    }
+    stats_error(STATS_DECODE_INT);
+    lua_pushnil(L);
+    lua_pushstring(L, strerror(errno));
+    return 2;
+}
+
+static int is_valid_lua(lua_State *L)
+{
+    size_t len                  = 0;
+    const char *b64             = luaL_checklstring(L, 1, &len);
+    const unsigned char *dectbl = checkdectbl(L, 2);
+
+    stats_update(STATS_IS_VALID, len, 0);
+    lua_pushboolean(L, b64m_is_valid((unsigned char *)b64, len, dectbl));
+    return 1;
+}
+
+static int decoded_len_lua(lua_State *L)
+{
+    size_t len      = 0;
+    const char *b64 = luaL_checklstring(L, 1, &len);
+    size_t bytes    = b64m_decoded_len((unsigned char *)b64, len);
+
+    stats_update(STATS_DECODED_LEN, 0, 0);
+    lua_pushinteger(L, (lua_Integer)bytes);
+    return 1;
+}
+
+static int encoded_len_lua(lua_State *L)
+{
+    lua_Integer n = luaL_checkinteger(L, 1);
+    int pad       = 1;
+    size_t bytes  = 0;
+
+    luaL_argcheck(L, n >= 0, 1, "n must not be negative");
+    if (!lua_isnoneornil(L, 2)) {
+        luaL_checktype(L, 2, LUA_TBOOLEAN);
+        pad = lua_toboolean(L, 2);
+    }
+    bytes = b64m_encoded_len((size_t)n, pad);
+    if (bytes == SIZE_MAX) {
+        stats_error(STATS_ENCODED_LEN);
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+    stats_update(STATS_ENCODED_LEN, 0, 0);
+    lua_pushinteger(L, (lua_Integer)bytes);
+    return 1;
+}
+
+#define BASE64MIX_ENCODER_MT "base64mix.encoder"
+#define BASE64MIX_DECODER_MT "base64mix.decoder"
+
+static int encoder_update_lua(lua_State *L)
+{
+    b64m_encoder_t *enc = luaL_checkudata(L, 1, BASE64MIX_ENCODER_MT);
+    size_t len          = 0;
+    const char *str     = luaL_checklstring(L, 2, &len);
+    size_t bytes        = b64m_encoder_update_len(enc, len);
+    luaL_Buffer b;
+    char *b64 = NULL;
+
+    if (bytes == SIZE_MAX) {
+        stats_error(STATS_ENCODER);
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+    stats_alloc(STATS_ENCODER);
+    b64   = luaL_buffinitsize(L, &b, bytes);
+    bytes = b64m_encoder_update(enc, (unsigned char *)b64,
+                                (unsigned char *)str, len);
+    stats_update(STATS_ENCODER, len, bytes);
+    luaL_pushresultsize(&b, bytes);
+    return 1;
+}
+
+static int encoder_final_lua(lua_State *L)
+{
+    b64m_encoder_t *enc = luaL_checkudata(L, 1, BASE64MIX_ENCODER_MT);
+    unsigned char b64[4];
+    size_t len = b64m_encoder_final(enc, b64);
+
+    stats_update(STATS_ENCODER, 0, len);
+    stats_alloc(STATS_ENCODER);
+    lua_pushlstring(L, (const char *)b64, len);
+    return 1;
+}
+
+static int encoder_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, BASE64MIX_ENCODER_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int encoder_lua(lua_State *L)
+{
+    const unsigned char *enctbl = checkenctbl(L, 1);
+    b64m_encoder_t *enc = lua_newuserdata(L, sizeof(b64m_encoder_t));
+
+    b64m_encoder_init(enc, enctbl);
+    luaL_getmetatable(L, BASE64MIX_ENCODER_MT);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+static int decoder_update_lua(lua_State *L)
+{
+    b64m_decoder_t *dec = luaL_checkudata(L, 1, BASE64MIX_DECODER_MT);
+    size_t len          = 0;
+    const char *b64     = luaL_checklstring(L, 2, &len);
+    size_t bytes        = b64m_decoder_update_len(dec, len);
+    luaL_Buffer b;
+    char *str = luaL_buffinitsize(L, &b, bytes);
+
+    stats_alloc(STATS_DECODER);
+    bytes = b64m_decoder_update(dec, (unsigned char *)str,
+                                (unsigned char *)b64, len);
+    if (bytes != SIZE_MAX) {
+        stats_update(STATS_DECODER, len, bytes);
+        luaL_pushresultsize(&b, bytes);
+        return 1;
+    }
+    // discard the invalid input
+    stats_error(STATS_DECODER);
+    b64m_decoder_init(dec, dec->dectbl);
+    lua_pushnil(L);
+    lua_pushstring(L, strerror(errno));
+    return 2;
+}
+
+static int decoder_final_lua(lua_State *L)
+{
+    b64m_decoder_t *dec = luaL_checkudata(L, 1, BASE64MIX_DECODER_MT);
+    unsigned char str[2];
+    size_t len = b64m_decoder_final(dec, str);
+
+    if (len != SIZE_MAX) {
+        stats_update(STATS_DECODER, 0, len);
+        stats_alloc(STATS_DECODER);
+        lua_pushlstring(L, (const char *)str, len);
+        return 1;
+    }
+    stats_error(STATS_DECODER);
+    lua_pushnil(L);
+    lua_pushstring(L, strerror(errno));
+    return 2;
+}
+
+static int decoder_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, BASE64MIX_DECODER_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int decoder_lua(lua_State *L)
+{
+    const unsigned char *dectbl = checkdectbl(L, 1);
+    b64m_decoder_t *dec = lua_newuserdata(L, sizeof(b64m_decoder_t));
+
+    b64m_decoder_init(dec, dectbl);
+    luaL_getmetatable(L, BASE64MIX_DECODER_MT);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+/**
+ * incremental jobs
+ *
+ * job_t encodes or decodes a large string at most step bytes at a time
+ * through the streaming encoder/decoder, so that the caller can hand the CPU
+ * back between the steps. the result is written into the space allocated by
+ * the allocator of the lua_State, and converted into a string after the last
+ * step.
+ */
+#define BASE64MIX_JOB_MT "base64mix.job"
+#define JOB_STEP         ((size_t)1024 * 1024)
+// maximum length of the final bytes of the streaming encoder/decoder
+#define JOB_TAIL         4
+
+typedef struct {
+    int decode;
+    size_t step;
+    const unsigned char *src;
+    size_t len;
+    size_t pos;
+    // references to the source and the result strings
+    int srcref;
+    int resref;
+    char *data;
+    size_t cap;
+    size_t nout;
+    // errno of the failure
+    int err;
+    lua_Alloc allocf;
+    void *ud;
+    union {
+        b64m_encoder_t enc;
+        b64m_decoder_t dec;
+    } s;
+} job_t;
+
+static void job_free(lua_State *L, job_t *job)
+{
+    if (job->data) {
+        job->allocf(job->ud, job->data, job->cap, 0);
+        job->data = NULL;
+    }
+    luaL_unref(L, LUA_REGISTRYINDEX, job->srcref);
+    job->srcref = LUA_NOREF;
+    job->src    = NULL;
+}
+
+/**
+ * job_reserve grows the result space to store more bytes and the final
+ * bytes of the streaming encoder/decoder.
+ * it returns -1 and sets errno if the space cannot be grown.
+ */
+static int job_reserve(job_t *job, size_t more)
+{
+    size_t cap = 0;
+    char *data = NULL;
+
+    if (more == SIZE_MAX || more > SIZE_MAX - JOB_TAIL - job->nout) {
+        errno = ERANGE;
+        return -1;
+    } else if ((cap = job->nout + more + JOB_TAIL) <= job->cap) {
+        return 0;
+    } else if (!(data = job->allocf(job->ud, job->data, job->cap, cap))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    job->data = data;
+    job->cap  = cap;
+    return 0;
+}
+
+/**
+ * job_step processes the next step of the job, and returns 1 if the job is
+ * completed, 0 if the input remains, or -1 if the input cannot be processed.
+ */
+static int job_step(lua_State *L, job_t *job)
+{
+    int id     = job->decode ? STATS_DECODE_JOB : STATS_ENCODE_JOB;
+    size_t nin = job->len - job->pos;
+    size_t n   = 0;
+
+    if (job->resref != LUA_NOREF) {
+        return 1;
+    } else if (job->err) {
+        return -1;
+    }
+
+    if (nin) {
+        unsigned char *dst         = NULL;
+        const unsigned char *chunk = job->src + job->pos;
+
+        if (nin > job->step) {
+            nin = job->step;
+        }
+        n = job->decode ? b64m_decoder_update_len(&job->s.dec, nin) :
+                          b64m_encoder_update_len(&job->s.enc, nin);
+        if (job_reserve(job, n) != 0) {
+            goto FAIL;
+        }
+        dst = (unsigned char *)job->data + job->nout;
+        n   = job->decode ? b64m_decoder_update(&job->s.dec, dst, chunk, nin) :
+                            b64m_encoder_update(&job->s.enc, dst, chunk, nin);
+        if (n == SIZE_MAX) {
+            goto FAIL;
+        }
+        stats_update(id, nin, n);
+        job->nout += n;
+        job->pos += nin;
+        if (job->pos < job->len) {
+            return 0;
+        }
+    }
+
+    n = job->decode ?
+            b64m_decoder_final(&job->s.dec,
+                               (unsigned char *)job->data + job->nout) :
+            b64m_encoder_final(&job->s.enc,
+                               (unsigned char *)job->data + job->nout);
+    if (n == SIZE_MAX) {
+        goto FAIL;
+    }
+    job->nout += n;
+    stats_alloc(id);
+    lua_pushlstring(L, job->data, job->nout);
+    job->resref = luaL_ref(L, LUA_REGISTRYINDEX);
+    job_free(L, job);
+    return 1;
+
+FAIL:
+    stats_error(id);
+    job->err = errno;
+    job_free(L, job);
+    return -1;
+}
+
+static int job_step_lua(lua_State *L)
+{
+    job_t *job = luaL_checkudata(L, 1, BASE64MIX_JOB_MT);
+
+    switch (job_step(L, job)) {
+    case -1:
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(job->err));
+        return 2;
+    default:
+        lua_pushboolean(L, job->resref != LUA_NOREF);
+        return 1;
+    }
+}
+
+static int job_result_lua(lua_State *L)
+{
+    job_t *job = luaL_checkudata(L, 1, BASE64MIX_JOB_MT);
+
+    if (job->err) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(job->err));
+        return 2;
+    } else if (job->resref == LUA_NOREF) {
+        lua_pushnil(L);
+        return 1;
+    }
+    lua_rawgeti(L, LUA_REGISTRYINDEX, job->resref);
+    return 1;
+}
+
+/**
+ * job_run_k runs the job until it is completed. on Lua 5.3 or later, it
+ * yields after each step if the running coroutine can yield, and continues
+ * when it is resumed. Lua 5.2 has lua_yieldk but no lua_isyieldable, and
+ * yielding from a coroutine that cannot yield raises an error, so it never
+ * yields on the older versions.
+ */
+#if LUA_VERSION_NUM >= 503
+static int job_run_k(lua_State *L, int status, lua_KContext ctx)
+#else
+static int job_run_k(lua_State *L)
+#endif
+{
+    job_t *job = luaL_checkudata(L, 1, BASE64MIX_JOB_MT);
+    int rv     = 0;
+
+#if LUA_VERSION_NUM >= 503
+    (void)status;
+    (void)ctx;
+#endif
+    lua_settop(L, 1);
+    while ((rv = job_step(L, job)) == 0) {
+#if LUA_VERSION_NUM >= 503
+        if (lua_isyieldable(L)) {
+            return lua_yieldk(L, 0, 0, job_run_k);
+        }
+#endif
+    }
+    return job_result_lua(L);
+}
+
+static int job_run_lua(lua_State *L)
+{
+#if LUA_VERSION_NUM >= 503
+    return job_run_k(L, LUA_OK, 0);
+#else
+    return job_run_k(L);
+#endif
+}
+
+static int job_gc_lua(lua_State *L)
+{
+    job_t *job = lua_touserdata(L, 1);
+
+    job_free(L, job);
+    luaL_unref(L, LUA_REGISTRYINDEX, job->resref);
+    job->resref = LUA_NOREF;
+    return 0;
+}
+
+static int job_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, BASE64MIX_JOB_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+/**
+ * newjob creates the job of the string at index 1 with the alphabet at
+ * index 2 and the step size at index 3.
+ */
+static int newjob(lua_State *L, int decode)
+{
+    size_t len               = 0;
+    const char *src          = luaL_checklstring(L, 1, &len);
+    lua_Integer n            = 0;
+    job_t *job               = NULL;
+    const unsigned char *tbl = NULL;
+    size_t bytes             = 0;
+
+    tbl = decode ? checkdectbl(L, 2) : checkenctbl(L, 2);
+    n   = luaL_optinteger(L, 3, (lua_Integer)JOB_STEP);
+    luaL_argcheck(L, n > 0, 3, "step must be greater than 0");
+    // the total of b64m_decoder_update_len() does not exceed len / 4 * 3
+    bytes = decode ? len / 4 * 3 :
+                     b64m_encoded_len(len, tbl == BASE64MIX_STDENC);
+
+    job  = lua_newuserdata(L, sizeof(job_t));
+    *job = (job_t){
+        .decode = decode,
+        .step   = (size_t)n,
+        .src    = (const unsigned char *)src,
+        .len    = len,
+        .srcref = LUA_NOREF,
+        .resref = LUA_NOREF,
+    };
+    job->allocf = lua_getallocf(L, &job->ud);
+    if (decode) {
+        b64m_decoder_init(&job->s.dec, tbl);
+    } else {
+        b64m_encoder_init(&job->s.enc, tbl);
+    }
+    luaL_getmetatable(L, BASE64MIX_JOB_MT);
+    lua_setmetatable(L, -2);
+
+    // allocate the space of the whole result at once
+    if (job_reserve(job, bytes) != 0) {
+        return luaL_error(L, "failed to create job: %s", strerror(errno));
+    }
+    // keep the source string alive
+    lua_pushvalue(L, 1);
+    job->srcref = luaL_ref(L, LUA_REGISTRYINDEX);
+    return 1;
+}
+
+static int encode_job_lua(lua_State *L)
+{
+    return newjob(L, 0);
+}
+
+static int decode_job_lua(lua_State *L)
+{
+    return newjob(L, 1);
+}
+
+static int buffer_tostring_lua(lua_State *L)
+{
+    buffer_t *buf = luaL_checkudata(L, 1, BASE64MIX_BUFFER_MT);
+
+    lua_pushlstring(L, buf->data ? buf->data : "", buf->len);
+    return 1;
+}
+
+static int buffer_len_lua(lua_State *L)
+{
+    buffer_t *buf = luaL_checkudata(L, 1, BASE64MIX_BUFFER_MT);
+
+    lua_pushinteger(L, (lua_Integer)buf->len);
+    return 1;
+}
+
+static int buffer_write_lua(lua_State *L)
+{
+    buffer_t *buf = luaL_checkudata(L, 1, BASE64MIX_BUFFER_MT);
+    int top       = lua_gettop(L);
+    size_t total  = buf->len;
+    int i         = 2;
+
+    // reserve the space for all strings at once
+    for (; i <= top; i++) {
+        size_t len = 0;
+
+        luaL_checklstring(L, i, &len);
+        if (len > SIZE_MAX - total) {
+            lua_pushnil(L);
+            lua_pushstring(L, strerror(ERANGE));
+            return 2;
+        }
+        total += len;
+    }
+    if (!buffer_reserve(buf, total)) {
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+    for (i = 2; i <= top; i++) {
+        size_t len      = 0;
+        const char *str = lua_tolstring(L, i, &len);
+
+        memcpy(buf->data + buf->len, str, len);
+        buf->len += len;
+    }
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int buffer_reset_lua(lua_State *L)
+{
+    buffer_t *buf = luaL_checkudata(L, 1, BASE64MIX_BUFFER_MT);
+
+    // keep the allocated space for the reuse
+    buf->len = 0;
+    lua_settop(L, 1);
+    return 1;
+}
+
+static int buffer_gc_lua(lua_State *L)
+{
+    buffer_t *buf = lua_touserdata(L, 1);
+
+    if (buf->data) {
+        buf->allocf(buf->ud, buf->data, buf->cap, 0);
+    }
+    buf->data = NULL;
+    buf->len  = 0;
+    buf->cap  = 0;
+    return 0;
+}
+
+static int buffer_name_lua(lua_State *L)
+{
+    lua_pushfstring(L, BASE64MIX_BUFFER_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int buffer_lua(lua_State *L)
+{
+    lua_Integer cap = luaL_optinteger(L, 1, 0);
+    buffer_t *buf   = NULL;
+
+    luaL_argcheck(L, cap >= 0, 1, "capacity must not be negative");
+    buf  = lua_newuserdata(L, sizeof(buffer_t));
+    *buf = (buffer_t){0};
+    buf->allocf = lua_getallocf(L, &buf->ud);
+    luaL_getmetatable(L, BASE64MIX_BUFFER_MT);
+    lua_setmetatable(L, -2);
+    if (cap > 0 && !buffer_reserve(buf, (size_t)cap)) {
+        return luaL_error(L, "failed to allocate buffer: %s", strerror(errno));
+    }
+    return 1;
+}
+
+#define BASE64MIX_CODEC_MT "base64mix.codec"
+
+static int codec_encode_lua(lua_State *L)
+{
+    b64m_codec_t *codec = luaL_checkudata(L, 1, BASE64MIX_CODEC_MT);
+    size_t len          = 0;
+    const char *str     = luaL_checklstring(L, 2, &len);
+    size_t bytes        = b64m_codec_encoded_len(codec, len);
+    luaL_Buffer b;
+    char *b64 = NULL;
+
+    if (bytes == SIZE_MAX) {
+        stats_error(STATS_CODEC);
+        lua_pushnil(L);
+        lua_pushstring(L, strerror(errno));
+        return 2;
+    }
+    stats_alloc(STATS_CODEC);
+    b64   = luaL_buffinitsize(L, &b, bytes);
+    bytes = b64m_codec_encode(codec, (unsigned char *)b64,
+                              (unsigned char *)str, len);
+    stats_update(STATS_CODEC, len, bytes);
+    luaL_pushresultsize(&b, bytes);
+    return 1;
+}
+
+static int codec_decode_lua(lua_State *L)
+{
+    b64m_codec_t *codec = luaL_checkudata(L, 1, BASE64MIX_CODEC_MT);
+    size_t len          = 0;
+    const char *b64     = luaL_checklstring(L, 2, &len);
+    size_t bytes        = 0;
+    luaL_Buffer b;
+    char *str = NULL;
+
+    bytes = b64m_codec_decoded_len(codec, (unsigned char *)b64, len);
+    str   = luaL_buffinitsize(L, &b, bytes);
+    stats_alloc(STATS_CODEC);
+    bytes = b64m_codec_decode(codec, (unsigned char *)str,
+                              (unsigned char *)b64, len);
+    if (bytes != SIZE_MAX) {
+        stats_update(STATS_CODEC, len, bytes);
+        luaL_pushresultsize(&b, bytes);
+        return 1;
+    }
+    stats_error(STATS_CODEC);
+    lua_pushnil(L);
+    lua_pushstring(L, strerror(errno));
+    return 2;
+}
+
+static int codec_tostring_lua(lua_State *L)
+{
+    lua_pushfstring(L, BASE64MIX_CODEC_MT ": %p", lua_touserdata(L, 1));
+    return 1;
+}
+
+static int codec_lua(lua_State *L)
+{
+    size_t len           = 0;
+    const char *alphabet = luaL_checklstring(L, 1, &len);
+    size_t plen          = 0;
+    const char *pad      = luaL_optlstring(L, 2, NULL, &plen);
+    b64m_codec_t *codec  = NULL;
+
+    luaL_argcheck(L, !pad || plen == 1, 2,
+                  "padchar must be a single character");
+    codec = lua_newuserdata(L, sizeof(b64m_codec_t));
+    if (b64m_codec_init(codec, (unsigned char *)alphabet, len,
+                        pad ? (unsigned char)*pad : -1) != 0) {
+        return luaL_argerror(L, 1,
+                             "alphabet must be 64 unique characters other "
+                             "than padchar");
+    }
+    luaL_getmetatable(L, BASE64MIX_CODEC_MT);
+    lua_setmetatable(L, -2);
+    return 1;
+}
+
+static int stats_lua(lua_State *L)
+{
+#if !defined(BASE64MIX_NO_STATS)
+    static const char *const names[] = {
+# define STATS_NAME(id, name) name,
+        STATS_LIST(STATS_NAME)
+# undef STATS_NAME
+    };
+    int i = 0;
+
+    lua_createtable(L, 0, STATS_MAX + 1);
+    for (; i < STATS_MAX; i++) {
+        lua_createtable(L, 0, 5);
+        lua_pushinteger(L, (lua_Integer)stats_load(STATS[i].calls));
+        lua_setfield(L, -2, "calls");
+        lua_pushinteger(L, (lua_Integer)stats_load(STATS[i].bytes_in));
+        lua_setfield(L, -2, "bytes_in");
+        lua_pushinteger(L, (lua_Integer)stats_load(STATS[i].bytes_out));
+        lua_setfield(L, -2, "bytes_out");
+        lua_pushinteger(L, (lua_Integer)stats_load(STATS[i].errors));
+        lua_setfield(L, -2, "errors");
+        lua_pushinteger(L, (lua_Integer)stats_load(STATS[i].allocs));
+        lua_setfield(L, -2, "allocs");
+        lua_setfield(L, -2, names[i]);
+    }
+#else
+    lua_createtable(L, 0, 1);
+#endif
+    lua_pushstring(L, B64M_KERNEL.name);
+    lua_setfield(L, -2, "kernel");
+    return 1;
+}
+
+static int reset_stats_lua(lua_State *L)
+{
+    (void)L;
+#if !defined(BASE64MIX_NO_STATS)
+    int i = 0;
+
+    for (; i < STATS_MAX; i++) {
+        stats_store(STATS[i].calls, 0);
+        stats_store(STATS[i].bytes_in, 0);
+        stats_store(STATS[i].bytes_out, 0);
+        stats_store(STATS[i].errors, 0);
+        stats_store(STATS[i].allocs, 0);
+    }
+#endif
+    return 0;
+}
+
+static void createmt(lua_State *L, const char *tname, const luaL_Reg mmethods[],
+                     const luaL_Reg methods[])
+{
+    const luaL_Reg *ptr = mmethods;
+
+    luaL_newmetatable(L, tname);
+    for (; ptr->name; ptr++) {
+        lstate_fn2tbl(L, ptr->name, ptr->func);
+    }
+    lua_pushstring(L, "__index");
+    lua_newtable(L);
+    for (ptr = methods; ptr->name; ptr++) {
+        lstate_fn2tbl(L, ptr->name, ptr->func);
+    }
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
 }
 
 LUALIB_API int luaopen_base64mix(lua_State *L)
 {
-    lua_createtable(L, 0, 5);
+    struct luaL_Reg pool_mmethods[] = {
+        {"__gc", pool_gc_lua},
+        {NULL,   NULL       }
+    };
+    struct luaL_Reg pool_methods[] = {
+        {NULL, NULL}
+    };
+    struct luaL_Reg scratch_mmethods[] = {
+        {"__gc", scratch_gc_lua},
+        {NULL,   NULL          }
+    };
+    struct luaL_Reg scratch_methods[] = {
+        {NULL, NULL}
+    };
+    struct luaL_Reg codec_mmethods[] = {
+        {"__tostring", codec_tostring_lua},
+        {NULL,         NULL              }
+    };
+    struct luaL_Reg codec_methods[] = {
+        {"encode", codec_encode_lua},
+        {"decode", codec_decode_lua},
+        {NULL,     NULL            }
+    };
+    struct luaL_Reg buffer_mmethods[] = {
+        {"__gc",       buffer_gc_lua  },
+        {"__len",      buffer_len_lua },
+        {"__tostring", buffer_name_lua},
+        {NULL,         NULL           }
+    };
+    struct luaL_Reg buffer_methods[] = {
+        {"tostring", buffer_tostring_lua},
+        {"len",      buffer_len_lua     },
+        {"write",    buffer_write_lua   },
+        {"reset",    buffer_reset_lua   },
+        {NULL,       NULL               }
+    };
+    struct luaL_Reg encoder_mmethods[] = {
+        {"__tostring", encoder_tostring_lua},
+        {NULL,         NULL                }
+    };
+    struct luaL_Reg encoder_methods[] = {
+        {"update", encoder_update_lua},
+        {"final",  encoder_final_lua },
+        {NULL,     NULL              }
+    };
+    struct luaL_Reg job_mmethods[] = {
+        {"__gc",       job_gc_lua      },
+        {"__tostring", job_tostring_lua},
+        {NULL,         NULL            }
+    };
+    struct luaL_Reg job_methods[] = {
+        {"step",   job_step_lua  },
+        {"run",    job_run_lua   },
+        {"result", job_result_lua},
+        {NULL,     NULL          }
+    };
+    struct luaL_Reg view_mmethods[] = {
+        {"__len",      view_len_lua     },
+        {"__tostring", view_tostring_lua},
+        {NULL,         NULL             }
+    };
+    struct luaL_Reg view_methods[] = {
+        {"len",      view_len_lua     },
+        {"sub",      view_sub_lua     },
+        {"tostring", view_tostring_lua},
+        {NULL,       NULL             }
+    };
+    struct luaL_Reg decoder_mmethods[] = {
+        {"__tostring", decoder_tostring_lua},
+        {NULL,         NULL                }
+    };
+    struct luaL_Reg decoder_methods[] = {
+        {"update", decoder_update_lua},
+        {"final",  decoder_final_lua },
+        {NULL,     NULL              }
+    };
+
+    // select the kernels for the running CPU
+    b64m_init();
+    // publish the function table for other C modules
+    lua_pushlightuserdata(L, (void *)base64mix_api());
+    lua_setfield(L, LUA_REGISTRYINDEX, BASE64MIX_REGISTRY_KEY);
+
+    createmt(L, BASE64MIX_POOL_MT, pool_mmethods, pool_methods);
+    createmt(L, BASE64MIX_SCRATCH_MT, scratch_mmethods, scratch_methods);
+    createmt(L, BASE64MIX_BUFFER_MT, buffer_mmethods, buffer_methods);
+    createmt(L, BASE64MIX_VIEW_MT, view_mmethods, view_methods);
+    createmt(L, BASE64MIX_CODEC_MT, codec_mmethods, codec_methods);
+    createmt(L, BASE64MIX_ENCODER_MT, encoder_mmethods, encoder_methods);
+    createmt(L, BASE64MIX_DECODER_MT, decoder_mmethods, decoder_methods);
+    createmt(L, BASE64MIX_JOB_MT, job_mmethods, job_methods);
+
+    lua_createtable(L, 0, 32);
     lstate_fn2tbl(L, "encode", encode_std_lua);
     lstate_fn2tbl(L, "decode", decode_std_lua);
     lstate_fn2tbl(L, "encodeURL", encode_url_lua);
+    lstate_fn2tbl(L, "encodeTo", encode_to_std_lua);
+    lstate_fn2tbl(L, "encodeURLTo", encode_to_url_lua);
     lstate_fn2tbl(L, "decodeURL", decode_url_lua);
     lstate_fn2tbl(L, "decodeMix", decode_mix_lua);
+    lstate_fn2tbl(L, "decodeCached", decode_cached_lua);
+    lstate_fn2tbl(L, "decodeSegments", decode_segments_lua);
+    lstate_fn2tbl(L, "decodeRange", decode_range_lua);
+    lstate_fn2tbl(L, "toURL", to_url_lua);
+    lstate_fn2tbl(L, "toStd", to_std_lua);
+    lstate_fn2tbl(L, "encodeInt", encode_int_lua);
+    lstate_fn2tbl(L, "decodeInt", decode_int_lua);
+    lstate_fn2tbl(L, "encodeJob", encode_job_lua);
+    lstate_fn2tbl(L, "decodeJob", decode_job_lua);
+    lstate_fn2tbl(L, "encodeMIME", encode_mime_lua);
+    lstate_fn2tbl(L, "decodeMIME", decode_mime_lua);
+    lstate_fn2tbl(L, "isValid", is_valid_lua);
+    lstate_fn2tbl(L, "decodedLen", decoded_len_lua);
+    lstate_fn2tbl(L, "encodedLen", encoded_len_lua);
+    lstate_fn2tbl(L, "stats", stats_lua);
+    lstate_fn2tbl(L, "resetStats", reset_stats_lua);
+    lstate_fn2tbl(L, "encodeBatch", encode_batch_std_lua);
+    lstate_fn2tbl(L, "decodeBatch", decode_batch_std_lua);
+    lstate_fn2tbl(L, "encodeURLBatch", encode_batch_url_lua);
+    lstate_fn2tbl(L, "decodeURLBatch", decode_batch_url_lua);
+    lstate_fn2tbl(L, "decodeMixBatch", decode_batch_mix_lua);
+    lstate_fn2tbl(L, "encoder", encoder_lua);
+    lstate_fn2tbl(L, "decoder", decoder_lua);
+    lstate_fn2tbl(L, "buffer", buffer_lua);
+    lstate_fn2tbl(L, "codec", codec_lua);
 
     return 1;
 }
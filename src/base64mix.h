@@ -28,8 +28,11 @@
 #define ___BASE64MIX_H___
 
 #include <errno.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
 
 static const unsigned char BASE64MIX_STDENC[64] = {
     'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M',
@@ -45,78 +48,56 @@ static const unsigned char BASE64MIX_URLENC[64] = {
     'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z',
     '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', '-', '_'};
 
-static inline char *b64m_encode(const unsigned char *src, size_t *len,
-                                const unsigned char enctbl[])
-{
-    unsigned char *res = NULL;
-    size_t tail        = *len;
-    size_t bytes       = (8.0 / 6.0 * (double)tail);
-    size_t surplus     = bytes % 4;
-
-    // add padding bytes
-    if (surplus) {
-        bytes += 4 - surplus;
-    }
-    // no-space for null-term or wrap around
-    if (bytes == SIZE_MAX || bytes < tail) {
-        errno = ERANGE;
-        return NULL;
-    }
+/**
+ * two-character encoding tables
+ *
+ * BASE64MIX_STDENC2 and BASE64MIX_URLENC2 map a 12-bit value to the two
+ * characters of BASE64MIX_STDENC and BASE64MIX_URLENC, so that the scalar
+ * encoder can emit 4 characters for each 3 bytes by two lookups.
+ */
+#define B64M_ALPHABET(X, a, c62, c63)                                          \
+    X(a, 'A') X(a, 'B') X(a, 'C') X(a, 'D') X(a, 'E') X(a, 'F') X(a, 'G')      \
+    X(a, 'H') X(a, 'I') X(a, 'J') X(a, 'K') X(a, 'L') X(a, 'M') X(a, 'N')      \
+    X(a, 'O') X(a, 'P') X(a, 'Q') X(a, 'R') X(a, 'S') X(a, 'T') X(a, 'U')      \
+    X(a, 'V') X(a, 'W') X(a, 'X') X(a, 'Y') X(a, 'Z') X(a, 'a') X(a, 'b')      \
+    X(a, 'c') X(a, 'd') X(a, 'e') X(a, 'f') X(a, 'g') X(a, 'h') X(a, 'i')      \
+    X(a, 'j') X(a, 'k') X(a, 'l') X(a, 'm') X(a, 'n') X(a, 'o') X(a, 'p')      \
+    X(a, 'q') X(a, 'r') X(a, 's') X(a, 't') X(a, 'u') X(a, 'v') X(a, 'w')      \
+    X(a, 'x') X(a, 'y') X(a, 'z') X(a, '0') X(a, '1') X(a, '2') X(a, '3')      \
+    X(a, '4') X(a, '5') X(a, '6') X(a, '7') X(a, '8') X(a, '9') X(a, c62)      \
+    X(a, c63)
+#define B64M_ALPHABET_HI(X, c62, c63)                                          \
+    X('A', c62, c63) X('B', c62, c63) X('C', c62, c63) X('D', c62, c63)        \
+    X('E', c62, c63) X('F', c62, c63) X('G', c62, c63) X('H', c62, c63)        \
+    X('I', c62, c63) X('J', c62, c63) X('K', c62, c63) X('L', c62, c63)        \
+    X('M', c62, c63) X('N', c62, c63) X('O', c62, c63) X('P', c62, c63)        \
+    X('Q', c62, c63) X('R', c62, c63) X('S', c62, c63) X('T', c62, c63)        \
+    X('U', c62, c63) X('V', c62, c63) X('W', c62, c63) X('X', c62, c63)        \
+    X('Y', c62, c63) X('Z', c62, c63) X('a', c62, c63) X('b', c62, c63)        \
+    X('c', c62, c63) X('d', c62, c63) X('e', c62, c63) X('f', c62, c63)        \
+    X('g', c62, c63) X('h', c62, c63) X('i', c62, c63) X('j', c62, c63)        \
+    X('k', c62, c63) X('l', c62, c63) X('m', c62, c63) X('n', c62, c63)        \
+    X('o', c62, c63) X('p', c62, c63) X('q', c62, c63) X('r', c62, c63)        \
+    X('s', c62, c63) X('t', c62, c63) X('u', c62, c63) X('v', c62, c63)        \
+    X('w', c62, c63) X('x', c62, c63) X('y', c62, c63) X('z', c62, c63)        \
+    X('0', c62, c63) X('1', c62, c63) X('2', c62, c63) X('3', c62, c63)        \
+    X('4', c62, c63) X('5', c62, c63) X('6', c62, c63) X('7', c62, c63)        \
+    X('8', c62, c63) X('9', c62, c63) X(c62, c62, c63) X(c63, c62, c63)
+#define B64M_ENC2_PAIR(a, b)       a, b,
+#define B64M_ENC2_ROW(a, c62, c63) B64M_ALPHABET(B64M_ENC2_PAIR, a, c62, c63)
 
-    if ((res = malloc(bytes + 1))) {
-        const unsigned char *cur = src;
-        unsigned char *ptr       = res;
-        uint8_t c                = -1;
-        uint8_t state            = 0;
-        size_t i                 = 0;
-
-        for (; i < tail; i++) {
-            switch (state) {
-            case 0:
-                c      = (*cur >> 2) & 0x3f;
-                *ptr++ = enctbl[c];
-                c      = (*cur & 0x3) << 4;
-                state  = 1;
-                break;
-            case 1:
-                c |= (*cur >> 4) & 0xf;
-                *ptr++ = enctbl[c];
-                c      = (*cur & 0xf) << 2;
-                state  = 2;
-                break;
-            case 2:
-                c |= (*cur >> 6) & 0x3;
-                *ptr++ = enctbl[c];
-                c      = *cur & 0x3f;
-                *ptr++ = enctbl[c];
-                c      = -1;
-                state  = 0;
-                break;
-            }
-            cur++;
-        }
+static const unsigned char BASE64MIX_STDENC2[4096 * 2] = {
+    B64M_ALPHABET_HI(B64M_ENC2_ROW, '+', '/')};
 
-        // append last bit
-        if (c != (uint8_t)-1) {
-            *ptr++ = enctbl[c];
-        }
-        // append padding if standard base64
-        if (enctbl == BASE64MIX_STDENC) {
-            for (i = ptr - res; i < bytes; i++) {
-                *ptr++ = '=';
-            }
-        }
-        // set result length
-        *len = ptr - res;
-        *ptr = 0;
-    }
+static const unsigned char BASE64MIX_URLENC2[4096 * 2] = {
+    B64M_ALPHABET_HI(B64M_ENC2_ROW, '-', '_')};
 
-    return (char *)res;
-}
-#define b64m_encode_std(src, len) b64m_encode(src, len, BASE64MIX_STDENC)
-#define b64m_encode_url(src, len) b64m_encode(src, len, BASE64MIX_URLENC)
+#undef B64M_ENC2_ROW
+#undef B64M_ENC2_PAIR
+#undef B64M_ALPHABET_HI
+#undef B64M_ALPHABET
 
-static const unsigned char BASE64MIX_STDDEC[255] = {
+static const unsigned char BASE64MIX_STDDEC[256] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 
@@ -145,9 +126,9 @@ static const unsigned char BASE64MIX_STDDEC[255] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
-static const unsigned char BASE64MIX_URLDEC[255] = {
+static const unsigned char BASE64MIX_URLDEC[256] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 
@@ -176,9 +157,9 @@ static const unsigned char BASE64MIX_URLDEC[255] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
-static const unsigned char BASE64MIX_DEC[255] = {
+static const unsigned char BASE64MIX_DEC[256] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
 
@@ -207,68 +188,2002 @@ static const unsigned char BASE64MIX_DEC[255] = {
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
     -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
-static inline char *b64m_decode(const unsigned char *src, size_t *len,
-                                const unsigned char dectbl[])
+/**
+ * pre-shifted decoding tables
+ *
+ * BASE64MIX_STDDEC32, BASE64MIX_URLDEC32 and BASE64MIX_DEC32 map a character
+ * to its 6-bit value shifted to the position in the 24-bit group, so that
+ * the scalar decoder can decode 4 characters by ORing 4 lookups.
+ * the invalid characters are mapped to 0x1000000, that sets the bit above
+ * the 24-bit group.
+ */
+#define B64M_DECVAL(c, c62a, c62b, c63a, c63b)                                 \
+    ((c) >= 'A' && (c) <= 'Z' ? (c) - 'A' :                                    \
+     (c) >= 'a' && (c) <= 'z' ? (c) - 'a' + 26 :                               \
+     (c) >= '0' && (c) <= '9' ? (c) - '0' + 52 :                               \
+     (c) == (c62a) || (c) == (c62b) ? 62 :                                     \
+     (c) == (c63a) || (c) == (c63b) ? 63 :                                     \
+                                      -1)
+#define B64M_DEC32(c, shift, c62a, c62b, c63a, c63b)                           \
+    (B64M_DECVAL(c, c62a, c62b, c63a, c63b) < 0 ?                              \
+         0x1000000U :                                                          \
+         (uint32_t)B64M_DECVAL(c, c62a, c62b, c63a, c63b) << (shift)),
+#define B64M_SEQ16(X, b, ...)                                                  \
+    X((b) + 0, __VA_ARGS__) X((b) + 1, __VA_ARGS__) X((b) + 2, __VA_ARGS__)    \
+    X((b) + 3, __VA_ARGS__) X((b) + 4, __VA_ARGS__) X((b) + 5, __VA_ARGS__)    \
+    X((b) + 6, __VA_ARGS__) X((b) + 7, __VA_ARGS__) X((b) + 8, __VA_ARGS__)    \
+    X((b) + 9, __VA_ARGS__) X((b) + 10, __VA_ARGS__)                           \
+    X((b) + 11, __VA_ARGS__) X((b) + 12, __VA_ARGS__)                          \
+    X((b) + 13, __VA_ARGS__) X((b) + 14, __VA_ARGS__)                          \
+    X((b) + 15, __VA_ARGS__)
+#define B64M_SEQ256(X, ...)                                                    \
+    B64M_SEQ16(X, 0, __VA_ARGS__) B64M_SEQ16(X, 16, __VA_ARGS__)               \
+    B64M_SEQ16(X, 32, __VA_ARGS__) B64M_SEQ16(X, 48, __VA_ARGS__)              \
+    B64M_SEQ16(X, 64, __VA_ARGS__) B64M_SEQ16(X, 80, __VA_ARGS__)              \
+    B64M_SEQ16(X, 96, __VA_ARGS__) B64M_SEQ16(X, 112, __VA_ARGS__)             \
+    B64M_SEQ16(X, 128, __VA_ARGS__) B64M_SEQ16(X, 144, __VA_ARGS__)            \
+    B64M_SEQ16(X, 160, __VA_ARGS__) B64M_SEQ16(X, 176, __VA_ARGS__)            \
+    B64M_SEQ16(X, 192, __VA_ARGS__) B64M_SEQ16(X, 208, __VA_ARGS__)            \
+    B64M_SEQ16(X, 224, __VA_ARGS__) B64M_SEQ16(X, 240, __VA_ARGS__)
+#define B64M_DEC32_TBL(c62a, c62b, c63a, c63b)                                 \
+    {                                                                          \
+        {B64M_SEQ256(B64M_DEC32, 18, c62a, c62b, c63a, c63b)},                 \
+        {B64M_SEQ256(B64M_DEC32, 12, c62a, c62b, c63a, c63b)},                 \
+        {B64M_SEQ256(B64M_DEC32, 6, c62a, c62b, c63a, c63b)},                  \
+        {B64M_SEQ256(B64M_DEC32, 0, c62a, c62b, c63a, c63b)},                  \
+    }
+
+static const uint32_t BASE64MIX_STDDEC32[4][256] =
+    B64M_DEC32_TBL('+', '+', '/', '/');
+static const uint32_t BASE64MIX_URLDEC32[4][256] =
+    B64M_DEC32_TBL('-', '-', '_', '_');
+static const uint32_t BASE64MIX_DEC32[4][256] =
+    B64M_DEC32_TBL('+', '-', '/', '_');
+
+#undef B64M_DEC32_TBL
+#undef B64M_SEQ256
+#undef B64M_SEQ16
+#undef B64M_DEC32
+#undef B64M_DECVAL
+
+/**
+ * SIMD kernels
+ *
+ * the kernels below are called by b64m_encode() and b64m_decode() to process
+ * the bulk of the input, and return the number of source bytes they consumed.
+ * the remaining bytes are processed by the scalar loop.
+ *
+ * the decode kernels stop at the first block that contains a character that
+ * is not in the alphabet (including the padding character), and leave it to
+ * the scalar loop to handle the padding and report the error.
+ *
+ * define BASE64MIX_NO_SIMD to disable them.
+ */
+#if !defined(BASE64MIX_NO_SIMD) && defined(__GNUC__) &&                        \
+    (defined(__x86_64__) || defined(__i386__))
+# define B64M_X86 1
+# include <immintrin.h>
+# define B64M_TARGET(t) __attribute__((target(t)))
+#elif !defined(BASE64MIX_NO_SIMD) && defined(__aarch64__) &&                   \
+    defined(__ARM_NEON)
+# define B64M_NEON 1
+# include <arm_neon.h>
+# if defined(__linux__)
+#  include <sys/auxv.h>
+#  ifndef HWCAP_ASIMD
+#   define HWCAP_ASIMD (1 << 1)
+#  endif
+# endif
+#endif
+
+typedef size_t (*b64m_encode_kernel_t)(unsigned char *dst,
+                                       const unsigned char *src, size_t len,
+                                       const unsigned char enctbl[]);
+
+typedef size_t (*b64m_decode_kernel_t)(unsigned char *dst,
+                                       const unsigned char *src, size_t len,
+                                       const unsigned char dectbl[]);
+
+typedef size_t (*b64m_validate_kernel_t)(const unsigned char *src,
+                                         size_t len,
+                                         const unsigned char dectbl[]);
+
+static inline const unsigned char *b64m_enc2tbl(const unsigned char enctbl[])
 {
-    unsigned char *res = NULL;
-    size_t bytes       = ((double)*len / (8.0 / 6.0));
-
-    if ((res = malloc(bytes + 1))) {
-        const unsigned char *cur = src;
-        unsigned char *ptr       = res;
-        uint8_t c                = 0;
-        uint32_t bit24           = 1;
-        size_t tail              = *len;
-        size_t i                 = 0;
-
-        for (; i < tail; i++) {
-            // ignore padding
-            if (*cur == '=') {
-                // check remaining characters
-                while (*(++cur)) {
-                    // remaining characters must be '='
-                    if (*cur != '=') {
-                        free((void *)res);
-                        errno = EINVAL;
-                        return NULL;
-                    }
-                }
-                break;
-            }
-            // invalid character
-            else if ((c = dectbl[*cur]) > 63) {
-                free((void *)res);
-                errno = EINVAL;
-                return NULL;
-            }
-            bit24 = bit24 << 6 | c;
-            if (bit24 & 0x1000000) {
-                *ptr++ = bit24 >> 16;
-                *ptr++ = bit24 >> 8;
-                *ptr++ = bit24;
-                bit24  = 1;
-            }
-            cur++;
+    if (enctbl == BASE64MIX_STDENC) {
+        return BASE64MIX_STDENC2;
+    } else if (enctbl == BASE64MIX_URLENC) {
+        return BASE64MIX_URLENC2;
+    }
+    return NULL;
+}
+
+static inline uint64_t b64m_load_be64(const unsigned char *p)
+{
+    return (uint64_t)p[0] << 56 | (uint64_t)p[1] << 48 |
+           (uint64_t)p[2] << 40 | (uint64_t)p[3] << 32 |
+           (uint64_t)p[4] << 24 | (uint64_t)p[5] << 16 |
+           (uint64_t)p[6] << 8 | (uint64_t)p[7];
+}
+
+/**
+ * b64m_encode_wide encodes the complete 3-byte groups of src by the
+ * two-character table enc2, and returns the number of source bytes
+ * consumed. 6 bytes are encoded at a time through the 64-bit loads.
+ */
+static inline size_t b64m_encode_wide(unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char enc2[])
+{
+    const unsigned char *cur = src;
+
+    // 8 bytes are loaded but only 6 bytes are consumed per iteration
+    for (; len >= 8; len -= 6) {
+        uint64_t v = b64m_load_be64(cur);
+
+        memcpy(dst, enc2 + (v >> 52 & 0xfff) * 2, 2);
+        memcpy(dst + 2, enc2 + (v >> 40 & 0xfff) * 2, 2);
+        memcpy(dst + 4, enc2 + (v >> 28 & 0xfff) * 2, 2);
+        memcpy(dst + 6, enc2 + (v >> 16 & 0xfff) * 2, 2);
+        cur += 6;
+        dst += 8;
+    }
+    for (; len >= 3; len -= 3) {
+        uint32_t v = (uint32_t)cur[0] << 16 | (uint32_t)cur[1] << 8 | cur[2];
+
+        memcpy(dst, enc2 + (v >> 12) * 2, 2);
+        memcpy(dst + 2, enc2 + (v & 0xfff) * 2, 2);
+        cur += 3;
+        dst += 4;
+    }
+
+    return cur - src;
+}
+
+/**
+ * b64m_encode_scalar is the portable kernel. it encodes the complete 3-byte
+ * groups of src, and returns the number of source bytes consumed.
+ */
+static inline size_t b64m_encode_scalar(unsigned char *dst,
+                                        const unsigned char *src, size_t len,
+                                        const unsigned char enctbl[])
+{
+    const unsigned char *enc2 = b64m_enc2tbl(enctbl);
+    const unsigned char *cur  = src;
+
+    if (enc2) {
+        return b64m_encode_wide(dst, src, len, enc2);
+    }
+
+    // alphabet without the two-character table
+    for (; len >= 3; len -= 3) {
+        uint32_t v = (uint32_t)cur[0] << 16 | (uint32_t)cur[1] << 8 | cur[2];
+
+        dst[0] = enctbl[v >> 18];
+        dst[1] = enctbl[v >> 12 & 0x3f];
+        dst[2] = enctbl[v >> 6 & 0x3f];
+        dst[3] = enctbl[v & 0x3f];
+        cur += 3;
+        dst += 4;
+    }
+
+    return cur - src;
+}
+
+static inline const uint32_t (*b64m_dec32tbl(const unsigned char dectbl[]))[256]
+{
+    if (dectbl == BASE64MIX_STDDEC) {
+        return BASE64MIX_STDDEC32;
+    } else if (dectbl == BASE64MIX_URLDEC) {
+        return BASE64MIX_URLDEC32;
+    } else if (dectbl == BASE64MIX_DEC) {
+        return BASE64MIX_DEC32;
+    }
+    return NULL;
+}
+
+/**
+ * b64m_decode_wide decodes the complete 4-character groups of src by the
+ * pre-shifted tables d, and returns the number of source characters
+ * consumed. the invalid characters are accumulated into a flag that is
+ * checked once per block, and the block that contains an invalid character
+ * (including the padding) is left to the caller.
+ */
+static inline size_t b64m_decode_wide(unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const uint32_t d[4][256])
+{
+    const unsigned char *cur = src;
+
+#define b64m_dec_group(s)                                                      \
+    (d[0][(s)[0]] | d[1][(s)[1]] | d[2][(s)[2]] | d[3][(s)[3]])
+#define b64m_dec_store(p, v)                                                   \
+    do {                                                                       \
+        (p)[0] = (v) >> 16;                                                    \
+        (p)[1] = (v) >> 8;                                                     \
+        (p)[2] = (v);                                                          \
+    } while (0)
+
+    // decode 16 characters per block
+    for (; len >= 16; len -= 16) {
+        uint32_t v0 = b64m_dec_group(cur);
+        uint32_t v1 = b64m_dec_group(cur + 4);
+        uint32_t v2 = b64m_dec_group(cur + 8);
+        uint32_t v3 = b64m_dec_group(cur + 12);
+
+        if ((v0 | v1 | v2 | v3) & 0xff000000) {
+            break;
         }
+        b64m_dec_store(dst, v0);
+        b64m_dec_store(dst + 3, v1);
+        b64m_dec_store(dst + 6, v2);
+        b64m_dec_store(dst + 9, v3);
+        cur += 16;
+        dst += 12;
+    }
+    for (; len >= 4; len -= 4) {
+        uint32_t v = b64m_dec_group(cur);
 
-        if (bit24 & 0x40000) {
-            *ptr++ = bit24 >> 10;
-            *ptr++ = bit24 >> 2;
-        } else if (bit24 & 0x1000) {
-            *ptr++ = bit24 >> 4;
+        if (v & 0xff000000) {
+            break;
         }
-        *ptr = 0;
-        // set result length
-        *len = ptr - res;
+        b64m_dec_store(dst, v);
+        cur += 4;
+        dst += 3;
     }
 
-    return (char *)res;
+#undef b64m_dec_store
+#undef b64m_dec_group
+
+    return cur - src;
 }
 
-#define b64m_decode_std(src, len) b64m_decode(src, len, BASE64MIX_STDDEC)
-#define b64m_decode_url(src, len) b64m_decode(src, len, BASE64MIX_URLDEC)
-#define b64m_decode_mix(src, len) b64m_decode(src, len, BASE64MIX_DEC)
+/**
+ * b64m_decode_scalar is the portable kernel. it decodes the complete
+ * 4-character groups of src, and returns the number of source characters
+ * consumed.
+ */
+static inline size_t b64m_decode_scalar(unsigned char *dst,
+                                        const unsigned char *src, size_t len,
+                                        const unsigned char dectbl[])
+{
+    const uint32_t(*d)[256] = b64m_dec32tbl(dectbl);
+
+    if (d) {
+        return b64m_decode_wide(dst, src, len, d);
+    }
+    // everything is processed by the scalar loop of b64m_decode_raw()
+    return 0;
+}
+
+/**
+ * b64m_validate_scalar is the portable validator. it returns the number of
+ * characters of the leading blocks of 16 characters that are all valid. the
+ * characters are looked up 16 at a time and the invalid characters are
+ * accumulated into a flag that is checked once per block.
+ */
+static inline size_t b64m_validate_scalar(const unsigned char *src,
+                                          size_t len,
+                                          const unsigned char dectbl[])
+{
+    const unsigned char *cur = src;
+
+    for (; len >= 16; len -= 16) {
+        unsigned char acc = 0;
+        int i             = 0;
+
+        for (; i < 16; i++) {
+            acc |= dectbl[cur[i]];
+        }
+        if (acc > 63) {
+            break;
+        }
+        cur += 16;
+    }
+
+    return cur - src;
+}
+
+#if defined(B64M_X86)
+
+/**
+ * the x86 kernels use the algorithm by Wojciech Mula and Daniel Lemire;
+ * http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+ *
+ * they only support the alphabets that have the same first 62 characters as
+ * BASE64MIX_STDENC.
+ */
+static inline int b64m_is_builtin_enctbl(const unsigned char enctbl[])
+{
+    return enctbl == BASE64MIX_STDENC || enctbl == BASE64MIX_URLENC;
+}
+
+B64M_TARGET("ssse3")
+static inline __m128i b64m_enc_lut_ssse3(const unsigned char enctbl[])
+{
+    // offsets to add to the 6-bit indices
+    return _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                         '0' - 52, (char)(enctbl[62] - 62),
+                         (char)(enctbl[63] - 63), 'A', 0, 0);
+}
+
+B64M_TARGET("ssse3")
+static inline __m128i b64m_enc_ssse3(__m128i in, __m128i lut)
+{
+    __m128i t0, t1, t2, t3, idx, res;
+
+    // split 12 bytes into 16 6-bit indices
+    in  = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5,
+                                            3, 4, 1, 2, 0, 1));
+    t0  = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    t1  = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    t2  = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    t3  = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    idx = _mm_or_si128(t1, t3);
+
+    // translate indices to characters
+    res = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    res = _mm_or_si128(res, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26),
+                                                         idx),
+                                          _mm_set1_epi8(13)));
+    res = _mm_shuffle_epi8(lut, res);
+    return _mm_add_epi8(res, idx);
+}
+
+B64M_TARGET("ssse3")
+static inline size_t b64m_encode_ssse3(unsigned char *dst,
+                                       const unsigned char *src, size_t len,
+                                       const unsigned char enctbl[])
+{
+    const unsigned char *cur = src;
+    __m128i lut;
+
+    if (!b64m_is_builtin_enctbl(enctbl)) {
+        return 0;
+    }
+
+    // 16 bytes are loaded but only 12 bytes are consumed per iteration
+    lut = b64m_enc_lut_ssse3(enctbl);
+    for (; len >= 16; len -= 12) {
+        __m128i v = _mm_loadu_si128((const __m128i *)cur);
+        _mm_storeu_si128((__m128i *)dst, b64m_enc_ssse3(v, lut));
+        cur += 12;
+        dst += 16;
+    }
+
+    return cur - src;
+}
+
+B64M_TARGET("avx2")
+static inline __m256i b64m_enc_avx2(__m256i in, __m256i lut)
+{
+    __m256i t0, t1, t2, t3, idx, res;
+
+    // split 2 x 12 bytes into 32 6-bit indices
+    in  = _mm256_shuffle_epi8(
+        in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    t0  = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+    t1  = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+    t2  = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+    t3  = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+    idx = _mm256_or_si256(t1, t3);
+
+    // translate indices to characters
+    res = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+    res = _mm256_or_si256(
+        res, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(26), idx),
+                              _mm256_set1_epi8(13)));
+    res = _mm256_shuffle_epi8(lut, res);
+    return _mm256_add_epi8(res, idx);
+}
+
+B64M_TARGET("avx2")
+static inline size_t b64m_encode_avx2(unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char enctbl[])
+{
+    const unsigned char *cur = src;
+    __m256i lut;
+
+    if (!b64m_is_builtin_enctbl(enctbl)) {
+        return 0;
+    }
+
+    // 28 bytes are loaded but only 24 bytes are consumed per iteration
+    lut = _mm256_broadcastsi128_si256(b64m_enc_lut_ssse3(enctbl));
+    for (; len >= 28; len -= 24) {
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)cur)),
+            _mm_loadu_si128((const __m128i *)(cur + 12)), 1);
+        _mm256_storeu_si256((__m256i *)dst, b64m_enc_avx2(v, lut));
+        cur += 24;
+        dst += 32;
+    }
+
+    return (cur - src) + b64m_encode_ssse3(dst, cur, len, enctbl);
+}
+
+/**
+ * the x86 decode kernels translate and validate characters by looking up
+ * the tables of 16 entries with pshufb;
+ * http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+ *
+ * a character is invalid if the entries of its low nibble in lo and its high
+ * nibble in B64M_DEC_HI have a common bit. the 6-bit value is the character
+ * plus the entry of roll at its high nibble. the characters that need the
+ * other offsets than the rest of their high nibble are moved to the other
+ * entries; a and c flip the 4th bit of the index, and b flips the 2nd bit.
+ */
+typedef struct {
+    unsigned char lo[16];
+    signed char roll[16];
+    char a;
+    char b;
+    char c;
+} b64m_declut_t;
+
+static const unsigned char B64M_DEC_HI[16] = {
+    0x40, 0x40, 0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+    0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+};
+
+static const b64m_declut_t B64M_STDDECLUT = {
+    .lo   = {0x55, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x43,
+             0x6a, 0x6b, 0x6b, 0x6b, 0x6a},
+    .roll = {19, 0, 0, 4, -65, -65, -71, -71, 0, 0, 16, 0, 0, 0, 0, 0},
+    .a    = '/',
+    .b    = '+',
+    .c    = '/',
+};
+
+static const b64m_declut_t B64M_URLDECLUT = {
+    .lo   = {0x55, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x43,
+             0x6b, 0x6b, 0x6a, 0x6b, 0x63},
+    .roll = {17, 0, 0, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, -32, 0, 0},
+    .a    = '_',
+    .b    = '-',
+    .c    = '_',
+};
+
+static const b64m_declut_t B64M_MIXDECLUT = {
+    .lo   = {0x55, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x41, 0x43,
+             0x6a, 0x6b, 0x6a, 0x6b, 0x62},
+    .roll = {17, 0, 19, 4, -65, -65, -71, -71, 0, 0, 16, 0, 0, -32, 0, 0},
+    .a    = '/',
+    .b    = '-',
+    .c    = '_',
+};
+
+static inline const b64m_declut_t *b64m_declut(const unsigned char dectbl[])
+{
+    if (dectbl == BASE64MIX_STDDEC) {
+        return &B64M_STDDECLUT;
+    } else if (dectbl == BASE64MIX_URLDEC) {
+        return &B64M_URLDECLUT;
+    } else if (dectbl == BASE64MIX_DEC) {
+        return &B64M_MIXDECLUT;
+    }
+    return NULL;
+}
+
+typedef struct {
+    __m128i lo;
+    __m128i hi;
+    __m128i roll;
+    __m128i a;
+    __m128i b;
+    __m128i c;
+} b64m_dec_ssse3_t;
+
+B64M_TARGET("ssse3")
+static inline void b64m_dec_init_ssse3(b64m_dec_ssse3_t *t,
+                                       const b64m_declut_t *lut)
+{
+    t->lo   = _mm_loadu_si128((const __m128i *)lut->lo);
+    t->hi   = _mm_loadu_si128((const __m128i *)B64M_DEC_HI);
+    t->roll = _mm_loadu_si128((const __m128i *)lut->roll);
+    t->a    = _mm_set1_epi8(lut->a);
+    t->b    = _mm_set1_epi8(lut->b);
+    t->c    = _mm_set1_epi8(lut->c);
+}
+
+// translates 16 characters into 6-bit values and returns a non-zero value
+// if any of them is invalid
+B64M_TARGET("ssse3")
+static inline int b64m_dec_ssse3(__m128i *v, const b64m_dec_ssse3_t *t)
+{
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i in         = *v;
+    __m128i hi         = _mm_and_si128(_mm_srli_epi16(in, 4), mask);
+    __m128i bad        = _mm_and_si128(
+        _mm_shuffle_epi8(t->lo, _mm_and_si128(in, mask)),
+        _mm_shuffle_epi8(t->hi, hi));
+    __m128i idx;
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) !=
+        0xffff) {
+        return 1;
+    }
+    idx = _mm_or_si128(_mm_cmpeq_epi8(in, t->a), _mm_cmpeq_epi8(in, t->c));
+    idx = _mm_xor_si128(hi, _mm_and_si128(idx, _mm_set1_epi8(8)));
+    idx = _mm_xor_si128(
+        idx, _mm_and_si128(_mm_cmpeq_epi8(in, t->b), _mm_set1_epi8(2)));
+    *v = _mm_add_epi8(in, _mm_shuffle_epi8(t->roll, idx));
+    return 0;
+}
+
+// packs 16 6-bit values into the first 12 bytes
+B64M_TARGET("ssse3")
+static inline __m128i b64m_dec_pack_ssse3(__m128i v)
+{
+    v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+    v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14,
+                                             13, 12, -1, -1, -1, -1));
+}
+
+B64M_TARGET("ssse3")
+static inline size_t b64m_decode_ssse3(unsigned char *dst,
+                                       const unsigned char *src, size_t len,
+                                       const unsigned char dectbl[])
+{
+    const unsigned char *cur = src;
+    const b64m_declut_t *lut = b64m_declut(dectbl);
+    b64m_dec_ssse3_t t;
+
+    if (!lut) {
+        return 0;
+    }
+
+    b64m_dec_init_ssse3(&t, lut);
+    for (; len >= 16; len -= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)cur);
+        uint32_t tail;
+
+        if (b64m_dec_ssse3(&v, &t)) {
+            break;
+        }
+        v = b64m_dec_pack_ssse3(v);
+        // store 12 bytes
+        _mm_storel_epi64((__m128i *)dst, v);
+        tail = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+        memcpy(dst + 8, &tail, 4);
+        cur += 16;
+        dst += 12;
+    }
+
+    return cur - src;
+}
+
+B64M_TARGET("ssse3")
+static inline size_t b64m_validate_ssse3(const unsigned char *src,
+                                         size_t len,
+                                         const unsigned char dectbl[])
+{
+    const unsigned char *cur = src;
+    const b64m_declut_t *lut = b64m_declut(dectbl);
+    const __m128i mask       = _mm_set1_epi8(0x0f);
+    __m128i lo, hi;
+
+    if (!lut) {
+        return b64m_validate_scalar(src, len, dectbl);
+    }
+
+    lo = _mm_loadu_si128((const __m128i *)lut->lo);
+    hi = _mm_loadu_si128((const __m128i *)B64M_DEC_HI);
+    for (; len >= 16; len -= 16) {
+        __m128i in  = _mm_loadu_si128((const __m128i *)cur);
+        __m128i bad = _mm_and_si128(
+            _mm_shuffle_epi8(lo, _mm_and_si128(in, mask)),
+            _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi16(in, 4), mask)));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, _mm_setzero_si128())) !=
+            0xffff) {
+            break;
+        }
+        cur += 16;
+    }
+
+    return cur - src;
+}
+
+B64M_TARGET("avx2")
+static inline int b64m_dec_avx2(__m256i *v, const b64m_dec_ssse3_t *t)
+{
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    const __m256i lo   = _mm256_broadcastsi128_si256(t->lo);
+    const __m256i hitb = _mm256_broadcastsi128_si256(t->hi);
+    const __m256i roll = _mm256_broadcastsi128_si256(t->roll);
+    __m256i in         = *v;
+    __m256i hi         = _mm256_and_si256(_mm256_srli_epi16(in, 4), mask);
+    __m256i bad        = _mm256_and_si256(
+        _mm256_shuffle_epi8(lo, _mm256_and_si256(in, mask)),
+        _mm256_shuffle_epi8(hitb, hi));
+    __m256i idx;
+
+    if (!_mm256_testz_si256(bad, bad)) {
+        return 1;
+    }
+    idx = _mm256_or_si256(
+        _mm256_cmpeq_epi8(in, _mm256_broadcastsi128_si256(t->a)),
+        _mm256_cmpeq_epi8(in, _mm256_broadcastsi128_si256(t->c)));
+    idx = _mm256_xor_si256(hi, _mm256_and_si256(idx, _mm256_set1_epi8(8)));
+    idx = _mm256_xor_si256(
+        idx,
+        _mm256_and_si256(
+            _mm256_cmpeq_epi8(in, _mm256_broadcastsi128_si256(t->b)),
+            _mm256_set1_epi8(2)));
+    *v = _mm256_add_epi8(in, _mm256_shuffle_epi8(roll, idx));
+    return 0;
+}
+
+B64M_TARGET("avx2")
+static inline size_t b64m_decode_avx2(unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char dectbl[])
+{
+    const unsigned char *cur = src;
+    const b64m_declut_t *lut = b64m_declut(dectbl);
+    b64m_dec_ssse3_t t;
+
+    if (!lut) {
+        return 0;
+    }
+
+    b64m_dec_init_ssse3(&t, lut);
+    for (; len >= 32; len -= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)cur);
+
+        if (b64m_dec_avx2(&v, &t)) {
+            break;
+        }
+        // pack 32 6-bit values into 2 x 12 bytes, and move them together
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(
+            v, _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1,
+                                -1, -1, 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12,
+                                -1, -1, -1, -1));
+        v = _mm256_permutevar8x32_epi32(
+            v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+        // store 24 bytes
+        _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i *)(dst + 16), _mm256_extracti128_si256(v, 1));
+        cur += 32;
+        dst += 24;
+    }
+
+    return (cur - src) + b64m_decode_ssse3(dst, cur, len, dectbl);
+}
+
+B64M_TARGET("avx2")
+static inline size_t b64m_validate_avx2(const unsigned char *src,
+                                        size_t len,
+                                        const unsigned char dectbl[])
+{
+    const unsigned char *cur = src;
+    const b64m_declut_t *lut = b64m_declut(dectbl);
+    const __m256i mask       = _mm256_set1_epi8(0x0f);
+    __m256i lo, hi;
+
+    if (!lut) {
+        return b64m_validate_scalar(src, len, dectbl);
+    }
+
+    lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)lut->lo));
+    hi = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)B64M_DEC_HI));
+    for (; len >= 32; len -= 32) {
+        __m256i in  = _mm256_loadu_si256((const __m256i *)cur);
+        __m256i bad = _mm256_and_si256(
+            _mm256_shuffle_epi8(lo, _mm256_and_si256(in, mask)),
+            _mm256_shuffle_epi8(
+                hi, _mm256_and_si256(_mm256_srli_epi16(in, 4), mask)));
+
+        if (!_mm256_testz_si256(bad, bad)) {
+            break;
+        }
+        cur += 32;
+    }
+
+    return (cur - src) + b64m_validate_ssse3(cur, len, dectbl);
+}
+
+#elif defined(B64M_NEON)
+
+static inline size_t b64m_encode_neon(unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char enctbl[])
+{
+    const unsigned char *cur = src;
+    const uint8x16_t mask    = vdupq_n_u8(0x3f);
+    uint8x16x4_t tbl;
+
+    tbl.val[0] = vld1q_u8(enctbl);
+    tbl.val[1] = vld1q_u8(enctbl + 16);
+    tbl.val[2] = vld1q_u8(enctbl + 32);
+    tbl.val[3] = vld1q_u8(enctbl + 48);
+    for (; len >= 48; len -= 48) {
+        uint8x16x3_t in = vld3q_u8(cur);
+        uint8x16x4_t out;
+
+        // split 3 x 16 bytes into 4 x 16 6-bit indices
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(
+            vorrq_u8(vshrq_n_u8(in.val[1], 4), vshlq_n_u8(in.val[0], 4)), mask);
+        out.val[2] = vandq_u8(
+            vorrq_u8(vshrq_n_u8(in.val[2], 6), vshlq_n_u8(in.val[1], 2)), mask);
+        out.val[3] = vandq_u8(in.val[2], mask);
+        // translate indices to characters
+        out.val[0] = vqtbl4q_u8(tbl, out.val[0]);
+        out.val[1] = vqtbl4q_u8(tbl, out.val[1]);
+        out.val[2] = vqtbl4q_u8(tbl, out.val[2]);
+        out.val[3] = vqtbl4q_u8(tbl, out.val[3]);
+        vst4q_u8(dst, out);
+        cur += 48;
+        dst += 64;
+    }
+
+    return cur - src;
+}
+
+/**
+ * the NEON decode kernel looks up the first 128 entries of the table, so it
+ * works on any alphabet of the ASCII characters.
+ */
+static inline size_t b64m_decode_neon(unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char dectbl[])
+{
+    const unsigned char *cur = src;
+    const uint8x16_t off     = vdupq_n_u8(64);
+    uint8x16x4_t lo;
+    uint8x16x4_t hi;
+
+    lo.val[0] = vld1q_u8(dectbl);
+    lo.val[1] = vld1q_u8(dectbl + 16);
+    lo.val[2] = vld1q_u8(dectbl + 32);
+    lo.val[3] = vld1q_u8(dectbl + 48);
+    hi.val[0] = vld1q_u8(dectbl + 64);
+    hi.val[1] = vld1q_u8(dectbl + 80);
+    hi.val[2] = vld1q_u8(dectbl + 96);
+    hi.val[3] = vld1q_u8(dectbl + 112);
+    for (; len >= 64; len -= 64) {
+        uint8x16x4_t in = vld4q_u8(cur);
+        uint8x16x3_t out;
+        uint8x16_t err;
+        int i = 0;
+
+        // translate characters into 6-bit values; the invalid characters
+        // are translated into 0xff, and the non-ASCII characters have the
+        // highest bit set
+        err = vdupq_n_u8(0);
+        for (; i < 4; i++) {
+            uint8x16_t c = in.val[i];
+            in.val[i]    = vqtbx4q_u8(vqtbl4q_u8(lo, c), hi, vsubq_u8(c, off));
+            err          = vorrq_u8(err, vorrq_u8(in.val[i], c));
+        }
+        if (vmaxvq_u8(err) & 0x80) {
+            break;
+        }
+
+        // pack 4 x 16 6-bit values into 3 x 16 bytes
+        out.val[0] =
+            vorrq_u8(vshlq_n_u8(in.val[0], 2), vshrq_n_u8(in.val[1], 4));
+        out.val[1] =
+            vorrq_u8(vshlq_n_u8(in.val[1], 4), vshrq_n_u8(in.val[2], 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+        vst3q_u8(dst, out);
+        cur += 64;
+        dst += 48;
+    }
+
+    // the rest of the blocks of 64 characters
+    return (cur - src) + b64m_decode_scalar(dst, cur, len, dectbl);
+}
+
+static inline size_t b64m_validate_neon(const unsigned char *src, size_t len,
+                                        const unsigned char dectbl[])
+{
+    const unsigned char *cur = src;
+    const uint8x16_t off     = vdupq_n_u8(64);
+    uint8x16x4_t lo;
+    uint8x16x4_t hi;
+
+    // the invalid entries of the built-in tables have the highest bit set
+    if (!b64m_dec32tbl(dectbl)) {
+        return b64m_validate_scalar(src, len, dectbl);
+    }
+
+    lo.val[0] = vld1q_u8(dectbl);
+    lo.val[1] = vld1q_u8(dectbl + 16);
+    lo.val[2] = vld1q_u8(dectbl + 32);
+    lo.val[3] = vld1q_u8(dectbl + 48);
+    hi.val[0] = vld1q_u8(dectbl + 64);
+    hi.val[1] = vld1q_u8(dectbl + 80);
+    hi.val[2] = vld1q_u8(dectbl + 96);
+    hi.val[3] = vld1q_u8(dectbl + 112);
+    for (; len >= 64; len -= 64) {
+        uint8x16_t err = vdupq_n_u8(0);
+        int i          = 0;
+
+        for (; i < 4; i++) {
+            uint8x16_t c = vld1q_u8(cur + i * 16);
+
+            err = vorrq_u8(err, vorrq_u8(vqtbx4q_u8(vqtbl4q_u8(lo, c), hi,
+                                                    vsubq_u8(c, off)),
+                                         c));
+        }
+        if (vmaxvq_u8(err) & 0x80) {
+            break;
+        }
+        cur += 64;
+    }
+
+    // the rest of the blocks of 64 characters
+    return (cur - src) + b64m_validate_scalar(cur, len, dectbl);
+}
+
+#endif
+
+typedef struct {
+    const char *name;
+    b64m_encode_kernel_t encode;
+    b64m_decode_kernel_t decode;
+    b64m_validate_kernel_t validate;
+} b64m_kernel_t;
+
+static b64m_kernel_t B64M_KERNEL = {
+    .name     = "scalar",
+    .encode   = b64m_encode_scalar,
+    .decode   = b64m_decode_scalar,
+    .validate = b64m_validate_scalar,
+};
+
+/**
+ * b64m_init selects the kernels for the running CPU.
+ * it should be called once before encoding.
+ */
+static inline void b64m_init(void)
+{
+#if defined(B64M_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        B64M_KERNEL.name     = "avx2";
+        B64M_KERNEL.encode   = b64m_encode_avx2;
+        B64M_KERNEL.decode   = b64m_decode_avx2;
+        B64M_KERNEL.validate = b64m_validate_avx2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        B64M_KERNEL.name     = "ssse3";
+        B64M_KERNEL.encode   = b64m_encode_ssse3;
+        B64M_KERNEL.decode   = b64m_decode_ssse3;
+        B64M_KERNEL.validate = b64m_validate_ssse3;
+    }
+#elif defined(B64M_NEON)
+# if defined(__linux__)
+    if (!(getauxval(AT_HWCAP) & HWCAP_ASIMD)) {
+        return;
+    }
+# endif
+    B64M_KERNEL.name     = "neon";
+    B64M_KERNEL.encode   = b64m_encode_neon;
+    B64M_KERNEL.decode   = b64m_decode_neon;
+    B64M_KERNEL.validate = b64m_validate_neon;
+#endif
+}
+
+/**
+ * b64m_encoded_len returns the length of the string that the len bytes are
+ * encoded into. if pad is non-zero, the length includes the padding
+ * characters. it returns SIZE_MAX and sets ERANGE to errno if the length
+ * cannot be represented; the returned length always leaves room for a
+ * null-terminator.
+ */
+static inline size_t b64m_encoded_len(size_t len, int pad)
+{
+    size_t surplus = len % 3;
+
+    len /= 3;
+    // no-space for null-term or wrap around
+    if (len > (SIZE_MAX - 5) / 4) {
+        errno = ERANGE;
+        return SIZE_MAX;
+    } else if (!surplus) {
+        return len * 4;
+    }
+    return len * 4 + (pad ? 4 : surplus + 1);
+}
+
+/**
+ * b64m_encode_tail encodes the last len (less than 3) bytes of src into dst,
+ * and appends padchar up to the group boundary if padchar is not negative.
+ * it returns the number of bytes written.
+ */
+static inline size_t b64m_encode_tail(unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char enctbl[],
+                                      int padchar)
+{
+    unsigned char *ptr = dst;
+
+    // append last bits
+    if (len == 1) {
+        *ptr++ = enctbl[src[0] >> 2];
+        *ptr++ = enctbl[(src[0] & 0x3) << 4];
+    } else if (len == 2) {
+        *ptr++ = enctbl[src[0] >> 2];
+        *ptr++ = enctbl[(src[0] & 0x3) << 4 | src[1] >> 4];
+        *ptr++ = enctbl[(src[1] & 0xf) << 2];
+    }
+    // append padding
+    if (len && padchar >= 0) {
+        while ((ptr - dst) % 4) {
+            *ptr++ = padchar;
+        }
+    }
+
+    return ptr - dst;
+}
+
+/**
+ * b64m_encode_pad_raw encodes the len bytes of src into dst, and returns the
+ * number of bytes written. if pad is non-zero, the padding characters are
+ * appended. dst must have at least b64m_encoded_len(len, pad) bytes of
+ * space. the result is not null-terminated.
+ */
+static inline size_t b64m_encode_pad_raw(unsigned char *dst,
+                                         const unsigned char *src, size_t len,
+                                         const unsigned char enctbl[], int pad)
+{
+    unsigned char *ptr = dst;
+    size_t n           = 0;
+
+    // process the bulk of the input by the selected kernel, and the rest of
+    // the complete groups by the scalar kernel
+    n = B64M_KERNEL.encode(ptr, src, len, enctbl);
+    src += n;
+    len -= n;
+    ptr += n / 3 * 4;
+    n = b64m_encode_scalar(ptr, src, len, enctbl);
+    src += n;
+    len -= n;
+    ptr += n / 3 * 4;
+    ptr += b64m_encode_tail(ptr, src, len, enctbl, pad ? '=' : -1);
+
+    return ptr - dst;
+}
+
+/**
+ * b64m_encode_raw encodes the len bytes of src into dst in the same way as
+ * b64m_encode_pad_raw(), and appends the padding characters if enctbl is
+ * BASE64MIX_STDENC.
+ */
+static inline size_t b64m_encode_raw(unsigned char *dst,
+                                     const unsigned char *src, size_t len,
+                                     const unsigned char enctbl[])
+{
+    return b64m_encode_pad_raw(dst, src, len, enctbl,
+                               enctbl == BASE64MIX_STDENC);
+}
+
+/**
+ * b64m_encode_pad_into encodes the len bytes of src into dst of dstlen
+ * bytes. if pad is non-zero, the padding characters are appended.
+ * the result is not null-terminated.
+ * it returns the number of bytes written, or returns -1 and sets errno to;
+ *  ERANGE:  the encoded length cannot be represented.
+ *  ENOBUFS: dstlen is too small to store the result.
+ */
+static inline ssize_t b64m_encode_pad_into(unsigned char *dst, size_t dstlen,
+                                           const unsigned char *src,
+                                           size_t len,
+                                           const unsigned char enctbl[],
+                                           int pad)
+{
+    size_t bytes = b64m_encoded_len(len, pad);
+
+    if (bytes == SIZE_MAX || bytes > (size_t)SSIZE_MAX) {
+        errno = ERANGE;
+        return -1;
+    } else if (bytes > dstlen) {
+        errno = ENOBUFS;
+        return -1;
+    }
+    return b64m_encode_pad_raw(dst, src, len, enctbl, pad);
+}
+
+/**
+ * b64m_encode_into encodes the len bytes of src into dst of dstlen bytes in
+ * the same way as b64m_encode_pad_into(), and appends the padding
+ * characters if enctbl is BASE64MIX_STDENC.
+ */
+static inline ssize_t b64m_encode_into(unsigned char *dst, size_t dstlen,
+                                       const unsigned char *src, size_t len,
+                                       const unsigned char enctbl[])
+{
+    return b64m_encode_pad_into(dst, dstlen, src, len, enctbl,
+                                enctbl == BASE64MIX_STDENC);
+}
+#define b64m_encode_into_std(dst, dstlen, src, len)                            \
+    b64m_encode_into(dst, dstlen, src, len, BASE64MIX_STDENC)
+#define b64m_encode_into_url(dst, dstlen, src, len)                            \
+    b64m_encode_into(dst, dstlen, src, len, BASE64MIX_URLENC)
+
+/**
+ * allocator callback
+ *
+ * b64m_alloc_t has the same signature as lua_Alloc, so lua_getallocf() can
+ * be passed to the functions below. if nsize is 0, it must free ptr of osize
+ * bytes and return NULL, otherwise it must resize ptr of osize bytes (or
+ * allocate if ptr is NULL) to nsize bytes and return it, or return NULL
+ * leaving ptr unchanged.
+ */
+typedef void *(*b64m_alloc_t)(void *ud, void *ptr, size_t osize,
+                              size_t nsize);
+
+/**
+ * b64m_default_alloc is the default allocator that uses realloc and free.
+ */
+static inline void *b64m_default_alloc(void *ud, void *ptr, size_t osize,
+                                       size_t nsize)
+{
+    (void)ud;
+    (void)osize;
+    if (nsize == 0) {
+        free(ptr);
+        return NULL;
+    }
+    return realloc(ptr, nsize);
+}
+
+/**
+ * b64m_encode_alloc encodes the *len bytes of src into the null-terminated
+ * string allocated by allocf, and stores its length into *len. the string
+ * must be freed as a block of *len + 1 bytes.
+ * it returns NULL if the allocation fails.
+ */
+static inline char *b64m_encode_alloc(const unsigned char *src, size_t *len,
+                                      const unsigned char enctbl[],
+                                      b64m_alloc_t allocf, void *ud)
+{
+    unsigned char *res = NULL;
+    size_t bytes = b64m_encoded_len(*len, enctbl == BASE64MIX_STDENC);
+
+    if (bytes != SIZE_MAX && (res = allocf(ud, NULL, 0, bytes + 1))) {
+        // set result length
+        *len      = b64m_encode_raw(res, src, *len, enctbl);
+        res[*len] = 0;
+    }
+
+    return (char *)res;
+}
+
+static inline char *b64m_encode(const unsigned char *src, size_t *len,
+                                const unsigned char enctbl[])
+{
+    return b64m_encode_alloc(src, len, enctbl, b64m_default_alloc, NULL);
+}
+#define b64m_encode_std(src, len) b64m_encode(src, len, BASE64MIX_STDENC)
+#define b64m_encode_url(src, len) b64m_encode(src, len, BASE64MIX_URLENC)
+
+/**
+ * b64m_decoded_len returns the length of the bytes that the len bytes of
+ * src are decoded into. the trailing padding characters are not counted.
+ * if src contains an invalid character, the actual result will be shorter.
+ */
+static inline size_t b64m_decoded_len(const unsigned char *src, size_t len)
+{
+    size_t surplus = 0;
+
+    // ignore padding
+    while (len && src[len - 1] == '=') {
+        len--;
+    }
+    // the remaining 1 character is discarded
+    surplus = len % 4;
+    return len / 4 * 3 + (surplus ? surplus - 1 : 0);
+}
+
+/**
+ * b64m_is_valid returns non-zero if b64m_decode_raw() accepts the len bytes
+ * of src, without decoding them. the bulk of the input is validated by the
+ * selected kernel, and the rest including the padding by the scalar loop.
+ */
+static inline int b64m_is_valid(const unsigned char *src, size_t len,
+                                const unsigned char dectbl[])
+{
+    const unsigned char *end = src + len;
+
+    src += B64M_KERNEL.validate(src, len, dectbl);
+    for (; src < end; src++) {
+        if (dectbl[*src] > 63) {
+            break;
+        }
+    }
+    // remaining characters must be '='
+    for (; src < end; src++) {
+        if (*src != '=') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * b64m_decode_tail decodes the len characters of src that are left by the
+ * kernels, and returns the number of bytes written. the characters after
+ * padchar must be padchar.
+ * it returns SIZE_MAX and sets EINVAL to errno if src contains an invalid
+ * character.
+ */
+static inline size_t b64m_decode_tail(unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char dectbl[],
+                                      int padchar)
+{
+    const unsigned char *end = src + len;
+    unsigned char *ptr       = dst;
+    uint8_t c                = 0;
+    uint32_t bit24           = 1;
+
+    for (; src < end; src++) {
+        // ignore padding
+        if (*src == padchar) {
+            // remaining characters must be padchar
+            while (++src < end) {
+                if (*src != padchar) {
+                    errno = EINVAL;
+                    return SIZE_MAX;
+                }
+            }
+            break;
+        }
+        // invalid character
+        else if ((c = dectbl[*src]) > 63) {
+            errno = EINVAL;
+            return SIZE_MAX;
+        }
+        bit24 = bit24 << 6 | c;
+        if (bit24 & 0x1000000) {
+            *ptr++ = bit24 >> 16;
+            *ptr++ = bit24 >> 8;
+            *ptr++ = bit24;
+            bit24  = 1;
+        }
+    }
+
+    if (bit24 & 0x40000) {
+        *ptr++ = bit24 >> 10;
+        *ptr++ = bit24 >> 2;
+    } else if (bit24 & 0x1000) {
+        *ptr++ = bit24 >> 4;
+    }
+
+    return ptr - dst;
+}
+
+/**
+ * b64m_decode_raw decodes the len bytes of src into dst, and returns the
+ * number of bytes written. dst must have at least b64m_decoded_len(src, len)
+ * bytes of space. the result is not null-terminated.
+ * it returns SIZE_MAX and sets EINVAL to errno if src contains an invalid
+ * character.
+ */
+static inline size_t b64m_decode_raw(unsigned char *dst,
+                                     const unsigned char *src, size_t len,
+                                     const unsigned char dectbl[])
+{
+    size_t i = 0;
+    size_t n = 0;
+
+    // process the bulk of the input by the selected kernel, and the
+    // remaining characters including the padding by the tail decoder
+    i = B64M_KERNEL.decode(dst, src, len, dectbl);
+    n = b64m_decode_tail(dst + i / 4 * 3, src + i, len - i, dectbl, '=');
+    if (n == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+
+    return i / 4 * 3 + n;
+}
+
+/**
+ * b64m_decode_range decodes only the 4-character groups of src that cover
+ * the n bytes from the offset of the decoded bytes, and returns the number
+ * of bytes written. the range is truncated at the end of the decoded bytes.
+ * dst must have at least n + 4 bytes of space. the result is not
+ * null-terminated.
+ * it returns SIZE_MAX and sets EINVAL to errno if the covering groups
+ * contain an invalid character.
+ */
+static inline size_t b64m_decode_range(unsigned char *dst,
+                                       const unsigned char *src, size_t len,
+                                       size_t offset, size_t n,
+                                       const unsigned char dectbl[])
+{
+    size_t total = b64m_decoded_len(src, len);
+    size_t head  = 0;
+    size_t tail  = 0;
+    size_t bytes = 0;
+
+    if (offset >= total || !n) {
+        return 0;
+    } else if (n > total - offset) {
+        n = total - offset;
+    }
+    // characters of the covering groups
+    head = offset / 3 * 4;
+    tail = (offset + n + 2) / 3 * 4;
+    if (tail > len) {
+        tail = len;
+    }
+    bytes = b64m_decode_raw(dst, src + head, tail - head, dectbl);
+    if (bytes == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+    // skip the leading bytes of the first group
+    offset %= 3;
+    if (bytes < offset + n) {
+        n = bytes > offset ? bytes - offset : 0;
+    }
+    memmove(dst, dst + offset, n);
+    return n;
+}
+
+/**
+ * b64m_decode_into decodes the len bytes of src into dst of dstlen bytes.
+ * the result is not null-terminated.
+ * it returns the number of bytes written, or returns -1 and sets errno to;
+ *  EINVAL:  src contains an invalid character.
+ *  ENOBUFS: dstlen is too small to store the result.
+ */
+static inline ssize_t b64m_decode_into(unsigned char *dst, size_t dstlen,
+                                       const unsigned char *src, size_t len,
+                                       const unsigned char dectbl[])
+{
+    size_t bytes = b64m_decoded_len(src, len);
+
+    if (bytes > dstlen) {
+        errno = ENOBUFS;
+        return -1;
+    } else if ((bytes = b64m_decode_raw(dst, src, len, dectbl)) == SIZE_MAX) {
+        return -1;
+    }
+    return bytes;
+}
+#define b64m_decode_into_std(dst, dstlen, src, len)                            \
+    b64m_decode_into(dst, dstlen, src, len, BASE64MIX_STDDEC)
+#define b64m_decode_into_url(dst, dstlen, src, len)                            \
+    b64m_decode_into(dst, dstlen, src, len, BASE64MIX_URLDEC)
+#define b64m_decode_into_mix(dst, dstlen, src, len)                            \
+    b64m_decode_into(dst, dstlen, src, len, BASE64MIX_DEC)
+
+/**
+ * b64m_decode_alloc decodes the *len bytes of src into the null-terminated
+ * bytes allocated by allocf, and stores its length into *len. the result
+ * must be freed as a block of *len + 1 bytes.
+ * it returns NULL if src contains an invalid character or the allocation
+ * fails.
+ */
+static inline char *b64m_decode_alloc(const unsigned char *src, size_t *len,
+                                      const unsigned char dectbl[],
+                                      b64m_alloc_t allocf, void *ud)
+{
+    size_t alen        = b64m_decoded_len(src, *len) + 1;
+    unsigned char *res = allocf(ud, NULL, 0, alen);
+    size_t bytes       = 0;
+
+    if (res) {
+        bytes = b64m_decode_raw(res, src, *len, dectbl);
+        if (bytes == SIZE_MAX) {
+            allocf(ud, res, alen, 0);
+            return NULL;
+        } else if (bytes + 1 != alen) {
+            // shrink to the actual size so that the caller can free it
+            unsigned char *ptr = allocf(ud, res, alen, bytes + 1);
+
+            if (!ptr) {
+                allocf(ud, res, alen, 0);
+                errno = ENOMEM;
+                return NULL;
+            }
+            res = ptr;
+        }
+        res[bytes] = 0;
+        // set result length
+        *len = bytes;
+    }
+
+    return (char *)res;
+}
+
+static inline char *b64m_decode(const unsigned char *src, size_t *len,
+                                const unsigned char dectbl[])
+{
+    return b64m_decode_alloc(src, len, dectbl, b64m_default_alloc, NULL);
+}
+
+#define b64m_decode_std(src, len) b64m_decode(src, len, BASE64MIX_STDDEC)
+#define b64m_decode_url(src, len) b64m_decode(src, len, BASE64MIX_URLDEC)
+#define b64m_decode_mix(src, len) b64m_decode(src, len, BASE64MIX_DEC)
+
+/**
+ * b64m_decode_inplace decodes the len bytes of buf into buf itself, and
+ * returns the number of bytes written. since the result is always shorter
+ * than the input, and every kernel writes behind the characters it has
+ * already read, no additional space is required. the result is not
+ * null-terminated.
+ * it returns SIZE_MAX and sets EINVAL to errno if buf contains an invalid
+ * character. in that case, the contents of buf are unspecified.
+ */
+static inline size_t b64m_decode_inplace(unsigned char *buf, size_t len,
+                                         const unsigned char dectbl[])
+{
+    return b64m_decode_raw(buf, buf, len, dectbl);
+}
+
+#define b64m_decode_inplace_std(buf, len)                                      \
+    b64m_decode_inplace(buf, len, BASE64MIX_STDDEC)
+#define b64m_decode_inplace_url(buf, len)                                      \
+    b64m_decode_inplace(buf, len, BASE64MIX_URLDEC)
+#define b64m_decode_inplace_mix(buf, len)                                      \
+    b64m_decode_inplace(buf, len, BASE64MIX_DEC)
+
+/**
+ * streaming encoder
+ *
+ * b64m_encoder_t carries the incomplete 3-byte group between the calls of
+ * b64m_encoder_update(), so that the input can be encoded chunk by chunk.
+ * the result of b64m_encoder_update() and b64m_encoder_final() are the same
+ * as b64m_encode() of the concatenated input.
+ */
+typedef struct {
+    const unsigned char *enctbl;
+    unsigned char buf[3];
+    uint8_t nbuf;
+} b64m_encoder_t;
+
+static inline void b64m_encoder_init(b64m_encoder_t *enc,
+                                     const unsigned char enctbl[])
+{
+    enc->enctbl = enctbl;
+    enc->nbuf   = 0;
+}
+
+/**
+ * b64m_encoder_update_len returns the size of the buffer required for
+ * b64m_encoder_update() to encode the len bytes.
+ */
+static inline size_t b64m_encoder_update_len(b64m_encoder_t *enc, size_t len)
+{
+    size_t nbuf = enc->nbuf;
+
+    if (len > SIZE_MAX - nbuf || (len + nbuf) / 3 > (SIZE_MAX - 5) / 4) {
+        errno = ERANGE;
+        return SIZE_MAX;
+    }
+    return (len + nbuf) / 3 * 4;
+}
+
+/**
+ * b64m_encoder_update encodes the complete 3-byte groups of the pending
+ * bytes and src into dst, and returns the number of bytes written. dst must
+ * have at least b64m_encoder_update_len(enc, len) bytes of space.
+ */
+static inline size_t b64m_encoder_update(b64m_encoder_t *enc,
+                                         unsigned char *dst,
+                                         const unsigned char *src, size_t len)
+{
+    unsigned char *ptr = dst;
+    size_t n           = 0;
+
+    // complete the pending group
+    if (enc->nbuf) {
+        while (len && enc->nbuf < 3) {
+            enc->buf[enc->nbuf++] = *src++;
+            len--;
+        }
+        if (enc->nbuf < 3) {
+            return 0;
+        }
+        ptr += b64m_encode_raw(ptr, enc->buf, 3, enc->enctbl);
+        enc->nbuf = 0;
+    }
+
+    n = len - len % 3;
+    ptr += b64m_encode_raw(ptr, src, n, enc->enctbl);
+    // keep the incomplete group
+    for (; n < len; n++) {
+        enc->buf[enc->nbuf++] = src[n];
+    }
+
+    return ptr - dst;
+}
+
+/**
+ * b64m_encoder_final encodes the pending bytes into dst of at least 4 bytes
+ * of space, and returns the number of bytes written. the encoder is reset
+ * to the initial state.
+ */
+static inline size_t b64m_encoder_final(b64m_encoder_t *enc,
+                                        unsigned char *dst)
+{
+    size_t n = b64m_encode_raw(dst, enc->buf, enc->nbuf, enc->enctbl);
+
+    enc->nbuf = 0;
+    return n;
+}
+
+/**
+ * streaming decoder
+ *
+ * b64m_decoder_t carries the incomplete 4-character group and whether the
+ * padding has appeared between the calls of b64m_decoder_update().
+ * the result of b64m_decoder_update() and b64m_decoder_final() are the same
+ * as b64m_decode() of the concatenated input.
+ */
+typedef struct {
+    const unsigned char *dectbl;
+    unsigned char buf[4];
+    uint8_t nbuf;
+    uint8_t padding;
+} b64m_decoder_t;
+
+static inline void b64m_decoder_init(b64m_decoder_t *dec,
+                                     const unsigned char dectbl[])
+{
+    dec->dectbl  = dectbl;
+    dec->nbuf    = 0;
+    dec->padding = 0;
+}
+
+/**
+ * b64m_decoder_update_len returns the size of the buffer required for
+ * b64m_decoder_update() to decode the len bytes.
+ */
+static inline size_t b64m_decoder_update_len(b64m_decoder_t *dec, size_t len)
+{
+    size_t n = len / 4 * 3;
+
+    // the pending characters and the surplus can form one more group
+    if (dec->nbuf + len % 4 >= 4) {
+        n += 3;
+    }
+    return n;
+}
+
+/**
+ * b64m_decoder_update decodes the complete 4-character groups of the
+ * pending characters and src into dst, and returns the number of bytes
+ * written. dst must have at least b64m_decoder_update_len(dec, len) bytes
+ * of space.
+ * it returns SIZE_MAX and sets EINVAL to errno if src contains an invalid
+ * character.
+ */
+static inline size_t b64m_decoder_update(b64m_decoder_t *dec,
+                                         unsigned char *dst,
+                                         const unsigned char *src, size_t len)
+{
+    unsigned char *ptr       = dst;
+    const unsigned char *pad = NULL;
+    size_t n                 = 0;
+
+    // find the padding
+    if (dec->padding) {
+        pad = src;
+    } else if ((pad = memchr(src, '=', len))) {
+        dec->padding = 1;
+    }
+    if (pad) {
+        // remaining characters must be '='
+        for (n = pad - src; n < len; n++) {
+            if (src[n] != '=') {
+                errno = EINVAL;
+                return SIZE_MAX;
+            }
+        }
+        len = pad - src;
+    }
+
+    // complete the pending group
+    if (dec->nbuf) {
+        while (len && dec->nbuf < 4) {
+            dec->buf[dec->nbuf++] = *src++;
+            len--;
+        }
+        if (dec->nbuf < 4) {
+            return 0;
+        } else if (b64m_decode_raw(ptr, dec->buf, 4, dec->dectbl) ==
+                   SIZE_MAX) {
+            return SIZE_MAX;
+        }
+        ptr += 3;
+        dec->nbuf = 0;
+    }
+
+    n = len - len % 4;
+    if ((n = b64m_decode_raw(ptr, src, n, dec->dectbl)) == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+    ptr += n;
+    // keep the incomplete group
+    for (n = len - len % 4; n < len; n++) {
+        dec->buf[dec->nbuf++] = src[n];
+    }
+
+    return ptr - dst;
+}
+
+/**
+ * b64m_decoder_final decodes the pending characters into dst of at least 2
+ * bytes of space, and returns the number of bytes written. the decoder is
+ * reset to the initial state.
+ * it returns SIZE_MAX and sets EINVAL to errno if the pending characters
+ * contain an invalid character.
+ */
+static inline size_t b64m_decoder_final(b64m_decoder_t *dec,
+                                        unsigned char *dst)
+{
+    size_t n = b64m_decode_raw(dst, dec->buf, dec->nbuf, dec->dectbl);
+
+    b64m_decoder_init(dec, dec->dectbl);
+    return n;
+}
+
+/**
+ * MIME line-wrapped encoding
+ *
+ * b64m_encode_mime_raw() inserts the line break of eollen bytes after every
+ * linelen characters while encoding, and no line break is appended after
+ * the last line. linelen must be a positive multiple of 4, so that every
+ * line except the last one consists of complete groups.
+ */
+
+/**
+ * b64m_encoded_mime_len returns the length of the string that the len bytes
+ * are encoded into by b64m_encode_mime_raw().
+ * it returns SIZE_MAX and sets errno to;
+ *  EINVAL: linelen is not a positive multiple of 4.
+ *  ERANGE: the length cannot be represented.
+ */
+static inline size_t b64m_encoded_mime_len(size_t len, int pad,
+                                           size_t linelen, size_t eollen)
+{
+    size_t bytes = 0;
+    size_t nbrk  = 0;
+
+    if (!linelen || linelen % 4) {
+        errno = EINVAL;
+        return SIZE_MAX;
+    } else if ((bytes = b64m_encoded_len(len, pad)) == SIZE_MAX || !bytes) {
+        return bytes;
+    }
+    // number of line breaks
+    nbrk = (bytes - 1) / linelen;
+    if (nbrk && eollen > (SIZE_MAX - 1 - bytes) / nbrk) {
+        errno = ERANGE;
+        return SIZE_MAX;
+    }
+    return bytes + nbrk * eollen;
+}
+
+/**
+ * b64m_encode_mime_raw encodes the len bytes of src into dst with the line
+ * breaks, and returns the number of bytes written. dst must have at least
+ * b64m_encoded_mime_len(len, 1, linelen, eollen) bytes of space. the result
+ * is not null-terminated.
+ */
+static inline size_t b64m_encode_mime_raw(unsigned char *dst,
+                                          const unsigned char *src, size_t len,
+                                          const unsigned char enctbl[],
+                                          size_t linelen,
+                                          const unsigned char *eol,
+                                          size_t eollen)
+{
+    unsigned char *ptr = dst;
+    size_t n           = linelen / 4 * 3;
+
+    // encode the complete lines
+    for (; len > n; len -= n) {
+        ptr += b64m_encode_raw(ptr, src, n, enctbl);
+        memcpy(ptr, eol, eollen);
+        ptr += eollen;
+        src += n;
+    }
+    // encode the last line
+    ptr += b64m_encode_raw(ptr, src, len, enctbl);
+
+    return ptr - dst;
+}
+
+/**
+ * whitespace-tolerant decoding
+ *
+ * b64m_decode_ws_raw() decodes src in the same way as b64m_decode_raw(),
+ * but skips the whitespace characters (' ', '\t', '\n', '\v', '\f' and
+ * '\r'). the runs of non-whitespace characters are fed to the streaming
+ * decoder, so that the complete groups of each line are still processed by
+ * the selected kernel.
+ */
+#define b64m_isspace(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+/**
+ * b64m_decode_ws_raw decodes the len bytes of src into dst, and returns the
+ * number of bytes written. dst must have at least b64m_decoded_len(src, len)
+ * bytes of space. the result is not null-terminated.
+ * it returns SIZE_MAX and sets EINVAL to errno if src contains an invalid
+ * character.
+ */
+static inline size_t b64m_decode_ws_raw(unsigned char *dst,
+                                        const unsigned char *src, size_t len,
+                                        const unsigned char dectbl[])
+{
+    const unsigned char *end  = src + len;
+    const unsigned char *head = NULL;
+    unsigned char *ptr        = dst;
+    size_t n                  = 0;
+    b64m_decoder_t dec;
+
+    b64m_decoder_init(&dec, dectbl);
+    while (src < end) {
+        // skip whitespace
+        while (src < end && b64m_isspace(*src)) {
+            src++;
+        }
+        head = src;
+        while (src < end && !b64m_isspace(*src)) {
+            src++;
+        }
+        if (src > head) {
+            n = b64m_decoder_update(&dec, ptr, head, src - head);
+            if (n == SIZE_MAX) {
+                return SIZE_MAX;
+            }
+            ptr += n;
+        }
+    }
+    if ((n = b64m_decoder_final(&dec, ptr)) == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+
+    return ptr + n - dst;
+}
+
+#undef b64m_isspace
+
+/**
+ * short inputs
+ *
+ * b64m_encode_short() and b64m_decode_short() process a short input such as
+ * an ID by the scalar code only, without the overhead of calling the
+ * kernels. b64m_encode_uint() and b64m_decode_uint() convert between an
+ * unsigned integer of 1 to 8 big-endian bytes and the unpadded string of at
+ * most B64M_UINT_MAXLEN characters on the stack.
+ */
+#define B64M_UINT_MAXLEN 11
+
+/**
+ * b64m_encode_short encodes the len bytes of src into dst in the same way as
+ * b64m_encode_pad_raw().
+ */
+static inline size_t b64m_encode_short(unsigned char *dst,
+                                       const unsigned char *src, size_t len,
+                                       const unsigned char enctbl[], int pad)
+{
+    size_t n = b64m_encode_scalar(dst, src, len, enctbl);
+
+    return n / 3 * 4 + b64m_encode_tail(dst + n / 3 * 4, src + n, len - n,
+                                        enctbl, pad ? '=' : -1);
+}
+
+/**
+ * b64m_decode_short decodes the len bytes of src into dst in the same way as
+ * b64m_decode_raw().
+ */
+static inline size_t b64m_decode_short(unsigned char *dst,
+                                       const unsigned char *src, size_t len,
+                                       const unsigned char dectbl[])
+{
+    size_t i = b64m_decode_scalar(dst, src, len, dectbl);
+    size_t n = b64m_decode_tail(dst + i / 4 * 3, src + i, len - i, dectbl,
+                                '=');
+
+    if (n == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+    return i / 4 * 3 + n;
+}
+
+/**
+ * b64m_encode_uint encodes the lower width (1 to 8) bytes of v in big-endian
+ * order into dst without the padding characters, and returns the number of
+ * bytes written. dst must have at least B64M_UINT_MAXLEN bytes of space.
+ */
+static inline size_t b64m_encode_uint(unsigned char *dst, uint64_t v,
+                                      size_t width,
+                                      const unsigned char enctbl[])
+{
+    unsigned char buf[8];
+    size_t i = width;
+
+    while (i) {
+        buf[--i] = (unsigned char)v;
+        v >>= 8;
+    }
+    return b64m_encode_short(dst, buf, width, enctbl, 0);
+}
+
+/**
+ * b64m_decode_uint decodes the len bytes of src as big-endian bytes of an
+ * unsigned integer into v, and returns the number of decoded bytes.
+ * it returns SIZE_MAX and sets errno to;
+ *  EINVAL: src contains an invalid character.
+ *  ERANGE: src is decoded into more than 8 bytes.
+ */
+static inline size_t b64m_decode_uint(uint64_t *v, const unsigned char *src,
+                                      size_t len, const unsigned char dectbl[])
+{
+    unsigned char buf[8];
+    size_t n = 0;
+    size_t i = 0;
+
+    if (b64m_decoded_len(src, len) > sizeof(buf)) {
+        errno = ERANGE;
+        return SIZE_MAX;
+    } else if ((n = b64m_decode_short(buf, src, len, dectbl)) == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+    *v = 0;
+    for (; i < n; i++) {
+        *v = *v << 8 | buf[i];
+    }
+    return n;
+}
+
+/**
+ * transcoding
+ *
+ * b64m_transcode_raw() converts the encoded string of one alphabet into
+ * another in one pass, without the intermediate decoded bytes. each
+ * character is mapped through dectbl and enctbl, and the invalid characters
+ * are accumulated into a flag that is checked once per 16 characters in the
+ * same way as b64m_is_valid(). the result is the same as encoding the result
+ * of b64m_decode_raw() with enctbl.
+ */
+
+/**
+ * b64m_transcoded_len returns the length of the string that the len bytes
+ * of src are transcoded into.
+ */
+static inline size_t b64m_transcoded_len(const unsigned char *src, size_t len,
+                                         int pad)
+{
+    return b64m_encoded_len(b64m_decoded_len(src, len), pad);
+}
+
+/**
+ * b64m_transcode_raw transcodes the len bytes of src decoded with dectbl
+ * into dst encoded with enctbl, and returns the number of bytes written.
+ * dst must have at least b64m_transcoded_len(src, len, pad) bytes of space.
+ * if pad is non-zero, the padding characters are appended. the result is
+ * not null-terminated.
+ * it returns SIZE_MAX and sets EINVAL to errno if src contains an invalid
+ * character.
+ */
+static inline size_t b64m_transcode_raw(unsigned char *dst,
+                                        const unsigned char *src, size_t len,
+                                        const unsigned char dectbl[],
+                                        const unsigned char enctbl[], int pad)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t n = 0;
+
+    // the block is validated before it is written, since dst is shorter
+    // than src if src contains the padding characters
+    for (; len - i >= 16; i += 16) {
+        unsigned char acc = 0;
+
+        for (j = 0; j < 16; j++) {
+            acc |= dectbl[src[i + j]];
+        }
+        if (acc > 63) {
+            break;
+        }
+        for (j = 0; j < 16; j++) {
+            dst[i + j] = enctbl[dectbl[src[i + j]]];
+        }
+    }
+    // find the end of the valid characters before writing them
+    n = i;
+    while (n < len && dectbl[src[n]] < 64) {
+        n++;
+    }
+    // remaining characters must be '='
+    for (j = n; j < len; j++) {
+        if (src[j] != '=') {
+            errno = EINVAL;
+            return SIZE_MAX;
+        }
+    }
+    // the remaining 1 character is discarded, since dst has no space for it
+    if (n % 4 == 1) {
+        n--;
+    }
+    for (; i < n; i++) {
+        dst[i] = enctbl[dectbl[src[i]]];
+    }
+
+    // the unused bits of the last character are cleared in the same way as
+    // the decoder
+    switch (i % 4) {
+    case 2:
+        dst[i - 1] = enctbl[dectbl[src[i - 1]] & 0x30];
+        break;
+    case 3:
+        dst[i - 1] = enctbl[dectbl[src[i - 1]] & 0x3c];
+        break;
+    }
+    if (pad) {
+        for (; i % 4; i++) {
+            dst[i] = '=';
+        }
+    }
+
+    return i;
+}
+
+/**
+ * custom alphabet codec
+ *
+ * b64m_codec_t holds the encode and decode tables built from an arbitrary
+ * alphabet of 64 characters, so that an alphabet such as bcrypt's or IMAP's
+ * modified base64 runs through the same kernels as the built-in alphabets.
+ * the table-driven kernels (NEON) are used as is, and the other kernels
+ * fall back to the wide scalar kernels with the tables of the codec.
+ */
+typedef struct {
+    unsigned char enctbl[64];
+    unsigned char dectbl[256];
+    unsigned char enc2[4096 * 2];
+    uint32_t dec32[4][256];
+    // padding character, or -1 if the padding is not used
+    int padchar;
+} b64m_codec_t;
+
+/**
+ * b64m_codec_init builds the tables of the alphabet of len characters.
+ * padchar is the padding character, or -1 to disable the padding.
+ * it returns 0 on success, or returns -1 and sets EINVAL to errno if the
+ * alphabet is not 64 unique characters or contains padchar.
+ */
+static inline int b64m_codec_init(b64m_codec_t *codec,
+                                  const unsigned char *alphabet, size_t len,
+                                  int padchar)
+{
+    size_t i = 0;
+
+    if (len != 64 || padchar < -1 || padchar > UCHAR_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(codec->dectbl, -1, sizeof(codec->dectbl));
+    for (; i < 64; i++) {
+        unsigned char c = alphabet[i];
+
+        if (codec->dectbl[c] != UCHAR_MAX || c == padchar) {
+            errno = EINVAL;
+            return -1;
+        }
+        codec->enctbl[i] = c;
+        codec->dectbl[c] = i;
+    }
+    codec->padchar = padchar;
+
+    // two-character table for the wide encoder
+    for (i = 0; i < 4096; i++) {
+        codec->enc2[i * 2]     = codec->enctbl[i >> 6];
+        codec->enc2[i * 2 + 1] = codec->enctbl[i & 0x3f];
+    }
+    // pre-shifted tables for the wide decoder
+    for (i = 0; i < 256; i++) {
+        uint32_t v = codec->dectbl[i];
+        int j      = 0;
+
+        for (; j < 4; j++) {
+            codec->dec32[j][i] = (v > 63) ? 0x1000000U : v << (18 - j * 6);
+        }
+    }
+    return 0;
+}
+
+/**
+ * b64m_codec_encoded_len returns the length of the string that the len
+ * bytes are encoded into by the codec.
+ * it returns SIZE_MAX and sets ERANGE to errno if the length cannot be
+ * represented.
+ */
+static inline size_t b64m_codec_encoded_len(const b64m_codec_t *codec,
+                                            size_t len)
+{
+    return b64m_encoded_len(len, codec->padchar >= 0);
+}
+
+/**
+ * b64m_codec_encode encodes the len bytes of src into dst, and returns the
+ * number of bytes written. dst must have at least
+ * b64m_codec_encoded_len(codec, len) bytes of space. the result is not
+ * null-terminated.
+ */
+static inline size_t b64m_codec_encode(const b64m_codec_t *codec,
+                                       unsigned char *dst,
+                                       const unsigned char *src, size_t len)
+{
+    unsigned char *ptr = dst;
+    size_t n           = 0;
+
+    n = B64M_KERNEL.encode(ptr, src, len, codec->enctbl);
+    src += n;
+    len -= n;
+    ptr += n / 3 * 4;
+    n = b64m_encode_wide(ptr, src, len, codec->enc2);
+    src += n;
+    len -= n;
+    ptr += n / 3 * 4;
+    ptr += b64m_encode_tail(ptr, src, len, codec->enctbl, codec->padchar);
+
+    return ptr - dst;
+}
+
+/**
+ * b64m_codec_decoded_len returns the length of the bytes that the len bytes
+ * of src are decoded into by the codec. the trailing padding characters are
+ * not counted.
+ */
+static inline size_t b64m_codec_decoded_len(const b64m_codec_t *codec,
+                                            const unsigned char *src,
+                                            size_t len)
+{
+    size_t surplus = 0;
+
+    // ignore padding
+    while (len && src[len - 1] == codec->padchar) {
+        len--;
+    }
+    // the remaining 1 character is discarded
+    surplus = len % 4;
+    return len / 4 * 3 + (surplus ? surplus - 1 : 0);
+}
+
+/**
+ * b64m_codec_decode decodes the len bytes of src into dst, and returns the
+ * number of bytes written. dst must have at least
+ * b64m_codec_decoded_len(codec, src, len) bytes of space. the result is not
+ * null-terminated.
+ * it returns SIZE_MAX and sets EINVAL to errno if src contains an invalid
+ * character.
+ */
+static inline size_t b64m_codec_decode(const b64m_codec_t *codec,
+                                       unsigned char *dst,
+                                       const unsigned char *src, size_t len)
+{
+    size_t i = 0;
+    size_t n = 0;
+
+    i = B64M_KERNEL.decode(dst, src, len, codec->dectbl);
+    i += b64m_decode_wide(dst + i / 4 * 3, src + i, len - i, codec->dec32);
+    n = b64m_decode_tail(dst + i / 4 * 3, src + i, len - i, codec->dectbl,
+                         codec->padchar);
+    if (n == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+
+    return i / 4 * 3 + n;
+}
 
 #endif
@@ -0,0 +1,93 @@
+/**
+ *  Copyright 2014 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ *  base64mix_abi.c
+ *  lua-base64mix
+ *
+ */
+
+#include "base64mix_abi.h"
+#include "base64mix.h"
+
+BASE64MIX_API const char *base64mix_init(void)
+{
+    b64m_init();
+    return B64M_KERNEL.name;
+}
+
+BASE64MIX_API size_t base64mix_encoded_len(size_t len, int pad)
+{
+    return b64m_encoded_len(len, pad);
+}
+
+BASE64MIX_API size_t base64mix_decoded_len(const unsigned char *src,
+                                           size_t len)
+{
+    return b64m_decoded_len(src, len);
+}
+
+BASE64MIX_API ssize_t base64mix_encode_into(unsigned char *dst, size_t dstlen,
+                                            const unsigned char *src,
+                                            size_t len, int alphabet, int pad)
+{
+    switch (alphabet) {
+    case BASE64MIX_ALPHABET_STD:
+        return b64m_encode_pad_into(dst, dstlen, src, len, BASE64MIX_STDENC,
+                                    pad);
+    case BASE64MIX_ALPHABET_URL:
+        return b64m_encode_pad_into(dst, dstlen, src, len, BASE64MIX_URLENC,
+                                    pad);
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+BASE64MIX_API ssize_t base64mix_decode_into(unsigned char *dst, size_t dstlen,
+                                            const unsigned char *src,
+                                            size_t len, int alphabet)
+{
+    switch (alphabet) {
+    case BASE64MIX_ALPHABET_STD:
+        return b64m_decode_into(dst, dstlen, src, len, BASE64MIX_STDDEC);
+    case BASE64MIX_ALPHABET_URL:
+        return b64m_decode_into(dst, dstlen, src, len, BASE64MIX_URLDEC);
+    case BASE64MIX_ALPHABET_MIX:
+        return b64m_decode_into(dst, dstlen, src, len, BASE64MIX_DEC);
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+BASE64MIX_API const base64mix_api_t *base64mix_api(void)
+{
+    static base64mix_api_t api = {
+        .version     = BASE64MIX_API_VERSION,
+        .encoded_len = base64mix_encoded_len,
+        .decoded_len = base64mix_decoded_len,
+        .encode_into = base64mix_encode_into,
+        .decode_into = base64mix_decode_into,
+    };
+
+    api.kernel = base64mix_init();
+    return &api;
+}
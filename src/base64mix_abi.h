@@ -0,0 +1,136 @@
+/**
+ *  base64mix_abi.h
+ *
+ *  Copyright 2014 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef ___BASE64MIX_ABI_H___
+#define ___BASE64MIX_ABI_H___
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * exported C ABI of the shared library
+ *
+ * these functions are exported from base64mix.so so that they can be called
+ * without going through the Lua C API (e.g. by LuaJIT FFI). the declarations
+ * are also written in the cdef of lib/ffi.lua, and must be kept in sync.
+ */
+
+#if defined(__GNUC__)
+# define BASE64MIX_API __attribute__((visibility("default")))
+#else
+# define BASE64MIX_API
+#endif
+
+// alphabets
+#define BASE64MIX_ALPHABET_STD 0
+#define BASE64MIX_ALPHABET_URL 1
+// decode only
+#define BASE64MIX_ALPHABET_MIX 2
+
+/**
+ * base64mix_init selects the kernels for the running CPU, and returns the
+ * name of the selected kernel. it is safe to call it more than once.
+ */
+BASE64MIX_API const char *base64mix_init(void);
+
+/**
+ * base64mix_encoded_len returns the length of the string that the len bytes
+ * are encoded into, or returns SIZE_MAX and sets ERANGE to errno.
+ */
+BASE64MIX_API size_t base64mix_encoded_len(size_t len, int pad);
+
+/**
+ * base64mix_decoded_len returns the length of the bytes that the len bytes
+ * of src are decoded into.
+ */
+BASE64MIX_API size_t base64mix_decoded_len(const unsigned char *src,
+                                           size_t len);
+
+/**
+ * base64mix_encode_into encodes the len bytes of src into dst of dstlen
+ * bytes with the alphabet (BASE64MIX_ALPHABET_STD or _URL). if pad is
+ * non-zero, the padding characters are appended.
+ * it returns the number of bytes written, or returns -1 and sets errno to;
+ *  EINVAL:  alphabet is invalid.
+ *  ERANGE:  the encoded length cannot be represented.
+ *  ENOBUFS: dstlen is too small to store the result.
+ */
+BASE64MIX_API ssize_t base64mix_encode_into(unsigned char *dst, size_t dstlen,
+                                            const unsigned char *src,
+                                            size_t len, int alphabet,
+                                            int pad);
+
+/**
+ * base64mix_decode_into decodes the len bytes of src into dst of dstlen
+ * bytes with the alphabet (BASE64MIX_ALPHABET_STD, _URL or _MIX).
+ * it returns the number of bytes written, or returns -1 and sets errno to;
+ *  EINVAL:  alphabet is invalid, or src contains an invalid character.
+ *  ENOBUFS: dstlen is too small to store the result.
+ */
+BASE64MIX_API ssize_t base64mix_decode_into(unsigned char *dst, size_t dstlen,
+                                            const unsigned char *src,
+                                            size_t len, int alphabet);
+
+/**
+ * function table
+ *
+ * luaopen_base64mix() publishes the function table of the exported
+ * functions as a light userdata in the registry field of
+ * BASE64MIX_REGISTRY_KEY, so that other C modules loaded into the same
+ * lua_State can call the kernels selected by this module without linking
+ * against it. the fields are only appended in the later versions, and the
+ * version field is incremented when they are added.
+ *
+ *  lua_getfield(L, LUA_REGISTRYINDEX, BASE64MIX_REGISTRY_KEY);
+ *  const base64mix_api_t *api = lua_touserdata(L, -1);
+ *  lua_pop(L, 1);
+ *  if (api && api->version >= 1) {
+ *      api->encode_into(dst, dstlen, src, len, BASE64MIX_ALPHABET_STD, 1);
+ *  }
+ */
+#define BASE64MIX_API_VERSION  1
+#define BASE64MIX_REGISTRY_KEY "base64mix.api"
+
+typedef struct {
+    int version;
+    // name of the selected kernel
+    const char *kernel;
+    size_t (*encoded_len)(size_t len, int pad);
+    size_t (*decoded_len)(const unsigned char *src, size_t len);
+    ssize_t (*encode_into)(unsigned char *dst, size_t dstlen,
+                           const unsigned char *src, size_t len, int alphabet,
+                           int pad);
+    ssize_t (*decode_into)(unsigned char *dst, size_t dstlen,
+                           const unsigned char *src, size_t len,
+                           int alphabet);
+} base64mix_api_t;
+
+/**
+ * base64mix_api selects the kernels in the same way as base64mix_init(),
+ * and returns the function table.
+ */
+BASE64MIX_API const base64mix_api_t *base64mix_api(void);
+
+#endif
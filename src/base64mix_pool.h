@@ -0,0 +1,310 @@
+/**
+ *  base64mix_pool.h
+ *
+ *  Copyright 2014 Masatoshi Teruya. All rights reserved.
+ *
+ *  Permission is hereby granted, free of charge, to any person obtaining a
+ *  copy of this software and associated documentation files (the "Software"),
+ *  to deal in the Software without restriction, including without limitation
+ *  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ *  and/or sell copies of the Software, and to permit persons to whom the
+ *  Software is furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be included in
+ *  all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ *  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ *  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ *  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ *  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ *  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef ___BASE64MIX_POOL_H___
+#define ___BASE64MIX_POOL_H___
+
+#include "base64mix.h"
+#include <pthread.h>
+
+/**
+ * thread pool for the parallel encoding/decoding
+ *
+ * the input is split into the blocks aligned to 3 bytes (encode) or 4
+ * characters (decode), and each block is processed by a worker thread into
+ * its own slot of the preallocated output.
+ */
+
+// maximum number of worker threads
+#define B64M_POOL_MAX 64
+// minimum number of bytes processed by one thread
+#ifndef B64M_POOL_BLOCK_MIN
+# define B64M_POOL_BLOCK_MIN (64 * 1024)
+#endif
+
+typedef struct b64m_task_st {
+    struct b64m_task_st *next;
+    // input
+    int decode;
+    int pad;
+    const unsigned char *tbl;
+    const unsigned char *src;
+    size_t len;
+    unsigned char *dst;
+    // output
+    size_t res;
+    int err;
+} b64m_task_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_cond_t done;
+    b64m_task_t *head;
+    size_t remain;
+    int closed;
+    int nthread;
+    pthread_t threads[B64M_POOL_MAX];
+} b64m_pool_t;
+
+static inline void b64m_pool_exec(b64m_task_t *task)
+{
+    if (task->decode) {
+        task->res =
+            b64m_decode_raw(task->dst, task->src, task->len, task->tbl);
+        task->err = task->res == SIZE_MAX ? errno : 0;
+    } else {
+        task->res = b64m_encode_pad_raw(task->dst, task->src, task->len,
+                                        task->tbl, task->pad);
+        task->err = 0;
+    }
+}
+
+static inline void *b64m_pool_worker(void *arg)
+{
+    b64m_pool_t *pool = (b64m_pool_t *)arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (1) {
+        b64m_task_t *task = pool->head;
+
+        if (!task) {
+            if (pool->closed) {
+                break;
+            }
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+            continue;
+        }
+        pool->head = task->next;
+        pthread_mutex_unlock(&pool->mutex);
+
+        b64m_pool_exec(task);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->remain == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+/**
+ * b64m_pool_init initializes the pool without threads. the threads are
+ * started on demand by b64m_pool_run().
+ * it returns 0 on success, or returns -1 and sets errno on failure.
+ */
+static inline int b64m_pool_init(b64m_pool_t *pool)
+{
+    int rv = 0;
+
+    *pool = (b64m_pool_t){0};
+    if ((rv = pthread_mutex_init(&pool->mutex, NULL))) {
+        errno = rv;
+        return -1;
+    } else if ((rv = pthread_cond_init(&pool->cond, NULL))) {
+        pthread_mutex_destroy(&pool->mutex);
+        errno = rv;
+        return -1;
+    } else if ((rv = pthread_cond_init(&pool->done, NULL))) {
+        pthread_cond_destroy(&pool->cond);
+        pthread_mutex_destroy(&pool->mutex);
+        errno = rv;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * b64m_pool_destroy stops and joins all threads.
+ */
+static inline void b64m_pool_destroy(b64m_pool_t *pool)
+{
+    int i = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->closed = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (; i < pool->nthread; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pool->nthread = 0;
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+/**
+ * b64m_pool_run executes the tasks; the first task is executed by the
+ * calling thread and the others are executed by the worker threads.
+ * if the threads cannot be started, the calling thread executes the rest.
+ */
+static inline void b64m_pool_run(b64m_pool_t *pool, b64m_task_t *tasks,
+                                 int ntask)
+{
+    int i = 1;
+
+    // start the threads on demand
+    while (pool->nthread < ntask - 1 && pool->nthread < B64M_POOL_MAX &&
+           pthread_create(&pool->threads[pool->nthread], NULL,
+                          b64m_pool_worker, pool) == 0) {
+        pool->nthread++;
+    }
+
+    if (pool->nthread) {
+        pthread_mutex_lock(&pool->mutex);
+        for (; i < ntask; i++) {
+            tasks[i].next = (i < ntask - 1) ? &tasks[i + 1] : NULL;
+        }
+        pool->head   = (ntask > 1) ? &tasks[1] : NULL;
+        pool->remain = ntask - 1;
+        pthread_cond_broadcast(&pool->cond);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    b64m_pool_exec(&tasks[0]);
+    // no thread available
+    for (; i < ntask; i++) {
+        b64m_pool_exec(&tasks[i]);
+    }
+
+    if (pool->nthread) {
+        pthread_mutex_lock(&pool->mutex);
+        while (pool->remain) {
+            pthread_cond_wait(&pool->done, &pool->mutex);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+// returns the number of tasks for the len bytes
+static inline int b64m_pool_ntask(size_t len, int nthread)
+{
+    size_t n = len / B64M_POOL_BLOCK_MIN;
+
+    if (nthread > B64M_POOL_MAX + 1) {
+        nthread = B64M_POOL_MAX + 1;
+    }
+    if (n < (size_t)nthread) {
+        return n ? (int)n : 1;
+    }
+    return nthread;
+}
+
+/**
+ * b64m_pool_encode encodes the len bytes of src into dst by nthread threads,
+ * and returns the number of bytes written. if pad is non-zero, the padding
+ * characters are appended. dst must have at least b64m_encoded_len(len, pad)
+ * bytes of space.
+ */
+static inline size_t b64m_pool_encode(b64m_pool_t *pool, int nthread,
+                                      unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char enctbl[], int pad)
+{
+    b64m_task_t tasks[B64M_POOL_MAX + 1];
+    int ntask = b64m_pool_ntask(len, nthread);
+    // block size aligned to 3 bytes
+    size_t bsz = len / ntask / 3 * 3;
+    size_t off = 0;
+    size_t res = 0;
+    int i      = 0;
+
+    for (; i < ntask; i++) {
+        // the blocks except the last one are never padded
+        tasks[i] = (b64m_task_t){
+            .pad = pad,
+            .tbl = enctbl,
+            .src = src + off,
+            .len = (i == ntask - 1) ? len - off : bsz,
+            .dst = dst + off / 3 * 4,
+        };
+        off += bsz;
+    }
+    b64m_pool_run(pool, tasks, ntask);
+
+    for (i = 0; i < ntask; i++) {
+        res += tasks[i].res;
+    }
+    return res;
+}
+
+/**
+ * b64m_pool_decode decodes the len bytes of src into dst by nthread threads,
+ * and returns the number of bytes written. dst must have at least
+ * b64m_decoded_len(src, len) bytes of space.
+ * it returns SIZE_MAX and sets EINVAL to errno if src contains an invalid
+ * character.
+ */
+static inline size_t b64m_pool_decode(b64m_pool_t *pool, int nthread,
+                                      unsigned char *dst,
+                                      const unsigned char *src, size_t len,
+                                      const unsigned char dectbl[])
+{
+    b64m_task_t tasks[B64M_POOL_MAX + 1];
+    size_t n   = len;
+    size_t bsz = 0;
+    size_t off = 0;
+    size_t res = 0;
+    int ntask  = 0;
+    int i      = 0;
+
+    // the trailing padding is decoded by the last block, so that the other
+    // blocks must not contain the padding
+    while (n && src[n - 1] == '=') {
+        n--;
+    }
+    ntask = b64m_pool_ntask(n, nthread);
+    // block size aligned to 4 characters
+    bsz = n / ntask / 4 * 4;
+    for (; i < ntask; i++) {
+        tasks[i] = (b64m_task_t){
+            .decode = 1,
+            .tbl    = dectbl,
+            .src    = src + off,
+            .len    = (i == ntask - 1) ? len - off : bsz,
+            .dst    = dst + off / 4 * 3,
+        };
+        off += bsz;
+    }
+    b64m_pool_run(pool, tasks, ntask);
+
+    for (i = 0; i < ntask; i++) {
+        if (tasks[i].res == SIZE_MAX) {
+            errno = tasks[i].err;
+            return SIZE_MAX;
+        } else if (i < ntask - 1 && tasks[i].res != bsz / 4 * 3) {
+            // the padding appeared in the middle of the input
+            errno = EINVAL;
+            return SIZE_MAX;
+        }
+        res += tasks[i].res;
+    }
+    return res;
+}
+
+#endif
@@ -0,0 +1,196 @@
+--
+-- end-to-end benchmark of the Lua API
+--
+-- usage: lua ./test/base64mix_bench.lua [min-seconds]
+--
+-- the results are printed in CSV format;
+--   api,op,bytes,calls,calls_per_sec,mb_per_s,kb_per_call
+-- bytes is the length of the raw (decoded) data, and mb_per_s is computed
+-- from it for both encode and decode. kb_per_call is the amount of memory
+-- allocated by one call, measured by collectgarbage('count') with the
+-- garbage collector stopped.
+--
+local randstr = require('string.random')
+local base64 = require('base64mix')
+local clock = os.clock
+local MINTIME = tonumber(arg and arg[1]) or 0.2
+local SIZES = {
+    16,
+    64,
+    1024,
+    64 * 1024,
+    1024 * 1024,
+}
+local BATCH_SIZE = 100
+local CHUNK_SIZE = 4096
+
+--- measure returns the number of calls of fn per second and the amount of
+--- memory allocated by one call in KB.
+--- @param fn function
+--- @return number calls
+--- @return number calls_per_sec
+--- @return number kb_per_call
+local function measure(fn)
+    -- warm up
+    fn()
+
+    -- measure the allocated memory with the garbage collector stopped
+    collectgarbage('collect')
+    collectgarbage('stop')
+    local kb = collectgarbage('count')
+    for _ = 1, 3 do
+        fn()
+    end
+    kb = (collectgarbage('count') - kb) / 3
+    collectgarbage('restart')
+    collectgarbage('collect')
+
+    -- repeat until the elapsed time exceeds MINTIME
+    local calls = 0
+    local elapsed = 0
+    local n = 1
+    local t = clock()
+    repeat
+        for _ = 1, n do
+            fn()
+        end
+        calls = calls + n
+        n = n * 2
+        elapsed = clock() - t
+    until elapsed >= MINTIME
+
+    return calls, calls / elapsed, kb
+end
+
+local function report(api, op, bytes, calls, cps, kb)
+    print(string.format('%s,%s,%d,%d,%.1f,%.1f,%.3f', api, op, bytes, calls,
+                        cps, bytes * cps / 1e6, kb))
+end
+
+-- returns the list of the chunks of s
+local function split(s)
+    local list = {}
+    for i = 1, #s, CHUNK_SIZE do
+        list[#list + 1] = s:sub(i, i + CHUNK_SIZE - 1)
+    end
+    return list
+end
+
+local BENCHMARKS = {
+    {
+        api = 'oneshot',
+        encode = function(src)
+            return function()
+                base64.encode(src)
+            end
+        end,
+        decode = function(enc)
+            return function()
+                base64.decode(enc)
+            end
+        end,
+    },
+    {
+        api = 'buffer',
+        encode = function(src)
+            local buf = base64.buffer()
+            return function()
+                base64.encode(src, buf)
+            end
+        end,
+        decode = function(enc)
+            local buf = base64.buffer()
+            return function()
+                base64.decode(enc, buf)
+            end
+        end,
+    },
+    {
+        api = 'substring',
+        encode = function(src)
+            local s = src .. src
+            return function()
+                base64.encode(s, 1, #src)
+            end
+        end,
+        decode = function(enc)
+            local s = enc .. enc
+            return function()
+                base64.decode(s, 1, #enc)
+            end
+        end,
+    },
+    {
+        -- one call processes BATCH_SIZE elements
+        api = 'batch',
+        calls = BATCH_SIZE,
+        maxbytes = 64 * 1024,
+        encode = function(src)
+            local list = {}
+            for i = 1, BATCH_SIZE do
+                list[i] = src
+            end
+            return function()
+                base64.encodeBatch(list)
+            end
+        end,
+        decode = function(enc)
+            local list = {}
+            for i = 1, BATCH_SIZE do
+                list[i] = enc
+            end
+            return function()
+                base64.decodeBatch(list)
+            end
+        end,
+    },
+    {
+        api = 'stream',
+        encode = function(src)
+            local list = split(src)
+            local enc = base64.encoder()
+            return function()
+                for i = 1, #list do
+                    enc:update(list[i])
+                end
+                enc:final()
+            end
+        end,
+        decode = function(enc)
+            local list = split(enc)
+            local dec = base64.decoder()
+            return function()
+                for i = 1, #list do
+                    dec:update(list[i])
+                end
+                dec:final()
+            end
+        end,
+    },
+}
+
+print(string.format('# %s', type(jit) == 'table' and jit.version or _VERSION))
+print('api,op,bytes,calls,calls_per_sec,mb_per_s,kb_per_call')
+for _, bytes in ipairs(SIZES) do
+    local src = randstr(bytes)
+    local enc = base64.encode(src)
+    assert(base64.decode(enc) == src)
+
+    for _, bench in ipairs(BENCHMARKS) do
+        local ncall = bench.calls or 1
+        for _, v in ipairs(bytes > (bench.maxbytes or bytes) and {} or {
+            {
+                op = 'encode',
+                fn = bench.encode(src),
+            },
+            {
+                op = 'decode',
+                fn = bench.decode(enc),
+            },
+        }) do
+            local calls, cps, kb = measure(v.fn)
+            report(bench.api, v.op, bytes, calls * ncall, cps * ncall,
+                   kb / ncall)
+        end
+    end
+end
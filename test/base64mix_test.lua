@@ -68,3 +68,1236 @@ local function test_decode_invalid_padding()
     assert.re_match(err, 'invalid argument', 'i')
 end
 test_decode_invalid_padding()
+
+local function test_decode_invalid_char_in_long_input()
+    local src = randstr(300)
+    local enc = assert(base64.encode(src))
+    local enc_url = assert(base64.encodeURL(src))
+
+    -- test that return error if invalid character is contained at any position
+    for i = 1, #enc_url, 7 do
+        for _, v in ipairs({
+            {
+                fn = base64.decode,
+                str = enc,
+            },
+            {
+                fn = base64.decodeURL,
+                str = enc_url,
+            },
+            {
+                fn = base64.decodeMix,
+                str = enc_url,
+            },
+        }) do
+            for _, c in ipairs({
+                '*',
+                '\0',
+                '\255',
+            }) do
+                local s = v.str:sub(1, i - 1) .. c .. v.str:sub(i + 1)
+                local _, err = v.fn(s)
+                assert.is_nil(_)
+                assert.re_match(err, 'invalid argument', 'i')
+            end
+        end
+    end
+end
+test_decode_invalid_char_in_long_input()
+
+local function test_encoder_decoder()
+    for _, alphabet in ipairs({
+        'std',
+        'url',
+    }) do
+        local encode = alphabet == 'std' and base64.encode or base64.encodeURL
+        for _ = 1, 50 do
+            local src = randstr(math.random(0, 300))
+            local enc = assert(encode(src))
+
+            -- test that encoder returns the same result as encode
+            local encoder = base64.encoder(alphabet)
+            assert.match(tostring(encoder), '^base64mix.encoder: ', false)
+            local list = {}
+            local i = 1
+            while i <= #src do
+                local n = math.random(0, 10)
+                list[#list + 1] = assert(encoder:update(src:sub(i, i + n - 1)))
+                i = i + n
+            end
+            list[#list + 1] = assert(encoder:final())
+            assert.equal(table.concat(list), enc)
+
+            -- test that decoder returns the same result as decode
+            for _, v in ipairs({
+                alphabet,
+                'mix',
+            }) do
+                local decoder = base64.decoder(v)
+                assert.match(tostring(decoder), '^base64mix.decoder: ', false)
+                list = {}
+                i = 1
+                while i <= #enc do
+                    local n = math.random(0, 10)
+                    list[#list + 1] = assert(
+                                          decoder:update(enc:sub(i, i + n - 1)))
+                    i = i + n
+                end
+                list[#list + 1] = assert(decoder:final())
+                assert.equal(table.concat(list), src)
+            end
+        end
+    end
+
+    -- test that decoder returns error if invalid character
+    local decoder = base64.decoder()
+    assert.equal(decoder:update('aGVs'), 'hel')
+    local _, err = decoder:update('bG*')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that decoder returns error if characters follow the padding
+    decoder = base64.decoder()
+    assert.equal(decoder:update('aGVsbG8='), 'hel')
+    _, err = decoder:update('a')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that decoder returns error if invalid character is pending
+    decoder = base64.decoder('url')
+    assert.equal(decoder:update('aG+'), '')
+    _, err = decoder:final()
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that throws an error if invalid alphabet
+    err = assert.throws(base64.encoder, 'mix')
+    assert.match(err, 'invalid option', false)
+end
+test_encoder_decoder()
+
+local function test_threads()
+    local src = randstr(1024 * 1024 + 7)
+    local enc = assert(base64.encode(src))
+    local enc_url = assert(base64.encodeURL(src))
+
+    -- test that parallel encoding returns the same result
+    for _, n in ipairs({
+        1,
+        2,
+        3,
+        8,
+    }) do
+        assert.equal(base64.encode(src, {
+            threads = n,
+        }), enc)
+        assert.equal(base64.encodeURL(src, {
+            threads = n,
+        }), enc_url)
+        assert.equal(base64.decode(enc, {
+            threads = n,
+        }), src)
+        assert.equal(base64.decodeURL(enc_url, {
+            threads = n,
+        }), src)
+        assert.equal(base64.decodeMix(enc_url, {
+            threads = n,
+        }), src)
+    end
+
+    -- test that return error if invalid character is contained in any block
+    for _, pos in ipairs({
+        1,
+        #enc / 2,
+        #enc - 8,
+    }) do
+        for _, c in ipairs({
+            '*',
+            '=',
+        }) do
+            local s = enc:sub(1, pos - 1) .. c .. enc:sub(pos + 1)
+            local _, err = base64.decode(s, {
+                threads = 4,
+            })
+            assert.is_nil(_)
+            assert.re_match(err, 'invalid argument', 'i')
+        end
+    end
+
+    -- test that throws an error if invalid threads option
+    local err = assert.throws(base64.encode, src, {
+        threads = 0,
+    })
+    assert.match(err, 'threads must be greater than 0', false)
+    err = assert.throws(base64.decode, enc, {
+        threads = 'foo',
+    })
+    assert.match(err, 'threads must be integer', false)
+end
+test_threads()
+
+local function test_batch()
+    local list = {}
+    for i = 1, 100 do
+        list[i] = randstr(math.random(0, 100))
+    end
+    list[#list + 1] = randstr(5000)
+
+    for _, v in ipairs({
+        {
+            enc = base64.encode,
+            dec = base64.decode,
+            encBatch = base64.encodeBatch,
+            decBatch = base64.decodeBatch,
+        },
+        {
+            enc = base64.encodeURL,
+            dec = base64.decodeURL,
+            encBatch = base64.encodeURLBatch,
+            decBatch = base64.decodeURLBatch,
+        },
+        {
+            enc = base64.encodeURL,
+            dec = base64.decodeMix,
+            encBatch = base64.encodeURLBatch,
+            decBatch = base64.decodeMixBatch,
+        },
+    }) do
+        -- test that batch functions return the same results
+        local encs, errs = v.encBatch(list)
+        assert.is_nil(errs)
+        assert.equal(#encs, #list)
+        for i, s in ipairs(list) do
+            assert.equal(encs[i], v.enc(s))
+        end
+        local decs
+        decs, errs = v.decBatch(encs)
+        assert.is_nil(errs)
+        assert.equal(#decs, #list)
+        for i, s in ipairs(list) do
+            assert.equal(decs[i], s)
+        end
+    end
+
+    -- test that per-element errors are reported without aborting the batch
+    local res, errs = base64.decodeBatch({
+        'aGVsbG8=',
+        'invalid=+',
+        true,
+        'd29ybGQ=',
+    })
+    assert.equal(res[1], 'hello')
+    assert.is_false(res[2])
+    assert.is_false(res[3])
+    assert.equal(res[4], 'world')
+    assert.re_match(errs[2], 'invalid argument', 'i')
+    assert.match(errs[3], 'string expected, got boolean', false)
+    assert.is_nil(errs[1])
+    assert.is_nil(errs[4])
+end
+test_batch()
+
+local function test_buffer()
+    local buf = base64.buffer(16)
+    assert.match(tostring(buf), '^base64mix%.buffer: ', false)
+    assert.equal(buf:len(), 0)
+    assert.equal(buf:tostring(), '')
+
+    -- test that encode/decode functions write the result into the buffer
+    for _, v in ipairs({
+        {
+            enc = base64.encode,
+            dec = base64.decode,
+        },
+        {
+            enc = base64.encodeURL,
+            dec = base64.decodeURL,
+        },
+        {
+            enc = base64.encodeURL,
+            dec = base64.decodeMix,
+        },
+    }) do
+        for _, n in ipairs({
+            0,
+            10,
+            100,
+            5000,
+        }) do
+            local src = randstr(n)
+            local enc = v.enc(src)
+            assert.equal(v.enc(src, buf), buf)
+            assert.equal(buf:tostring(), enc)
+            assert.equal(buf:len(), #enc)
+            assert.equal(#buf, #enc)
+            assert.equal(v.dec(enc, buf), buf)
+            assert.equal(buf:tostring(), src)
+            assert.equal(buf:len(), #src)
+        end
+    end
+
+    -- test that options can be passed after the buffer
+    local src = randstr(1024 * 1024)
+    assert.equal(base64.encode(src, buf, {
+        threads = 4,
+    }), buf)
+    assert.equal(buf:tostring(), base64.encode(src))
+    assert.equal(base64.decode(buf:tostring(), buf, {
+        threads = 4,
+    }), buf)
+    assert.equal(buf:tostring(), src)
+
+    -- test that reset clears the contents
+    assert.equal(buf:reset(), buf)
+    assert.equal(buf:len(), 0)
+    assert.equal(buf:tostring(), '')
+
+    -- test that return error if invalid character is contained
+    local _, err = base64.decode('invalid=+', buf)
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+    assert.equal(buf:len(), 0)
+
+    -- test that throws an error if invalid argument
+    err = assert.throws(base64.buffer, -1)
+    assert.match(err, 'capacity must not be negative', false)
+    err = assert.throws(base64.decode, 'aGVsbG8=', io.stdout)
+    assert.match(err, 'base64mix.buffer expected', false)
+end
+test_buffer()
+
+local function test_mime()
+    for _, n in ipairs({
+        0,
+        1,
+        56,
+        57,
+        58,
+        1000,
+    }) do
+        local src = randstr(n)
+        local enc = base64.encode(src)
+
+        -- test that lines are wrapped at 76 columns with CRLF by default
+        local mime = assert(base64.encodeMIME(src))
+        local lines = {}
+        for line in string.gmatch(mime .. '\r\n', '(.-)\r\n') do
+            lines[#lines + 1] = line
+        end
+        for i, line in ipairs(lines) do
+            if i < #lines then
+                assert.equal(#line, 76)
+            else
+                assert(#line <= 76)
+            end
+        end
+        assert.equal(table.concat(lines), enc)
+        assert.equal(assert(base64.decodeMIME(mime)), src)
+
+        -- test that linelen and eol can be specified
+        mime = assert(base64.encodeMIME(src, 64, '\n'))
+        assert.equal((mime:gsub('\n', '')), enc)
+        assert.is_nil(string.find(mime, '[^\n]' .. string.rep('[^\n]', 64)))
+        assert.equal(assert(base64.decodeMIME(mime)), src)
+    end
+
+    -- test that decodeMIME skips whitespace characters
+    assert.equal(base64.decodeMIME(' aGVs\tbG8g\r\nd29y\nbGQ=\r\n'),
+                 'hello world')
+
+    -- test that return error if invalid character is contained
+    local _, err = base64.decodeMIME('aGVs*bG8=')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that throws an error if invalid linelen
+    err = assert.throws(base64.encodeMIME, 'hello', 75)
+    assert.match(err, 'linelen must be a positive multiple of 4', false)
+end
+test_mime()
+
+local function test_validate_and_len()
+    for _, n in ipairs({
+        0,
+        1,
+        2,
+        3,
+        100,
+        1000,
+    }) do
+        local src = randstr(n)
+        local enc = base64.encode(src)
+        local enc_url = base64.encodeURL(src)
+
+        -- test that isValid and decodedLen agree with decode
+        assert.equal(base64.isValid(enc), true)
+        assert.equal(base64.isValid(enc, 'std'), true)
+        assert.equal(base64.isValid(enc_url, 'url'), true)
+        assert.equal(base64.isValid(enc_url, 'mix'), true)
+        assert.equal(base64.decodedLen(enc), n)
+        assert.equal(base64.decodedLen(enc_url), n)
+
+        -- test that encodedLen returns the length of the encoded string
+        assert.equal(base64.encodedLen(n), #enc)
+        assert.equal(base64.encodedLen(n, true), #enc)
+        assert.equal(base64.encodedLen(n, false), #enc_url)
+    end
+
+    -- test that isValid returns false if invalid character is contained
+    assert.is_false(base64.isValid('aGVs*bG8='))
+    assert.is_false(base64.isValid('aGVsbG8=a'))
+    assert.is_false(base64.isValid('aGVs-bG8', 'std'))
+    assert.is_false(base64.isValid('aGVs+bG8', 'url'))
+    assert.equal(base64.isValid('aGVs-bG8', 'url'), true)
+
+    -- test that throws an error if invalid argument
+    local err = assert.throws(base64.isValid, 'aGVs', 'foo')
+    assert.match(err, 'invalid option', false)
+    err = assert.throws(base64.encodedLen, -1)
+    assert.match(err, 'n must not be negative', false)
+    err = assert.throws(base64.encodedLen, 1, 'foo')
+    assert.match(err, 'boolean expected', false)
+end
+test_validate_and_len()
+
+local function test_substring()
+    local src = randstr(100)
+    local enc = base64.encode(src)
+    local enc_url = base64.encodeURL(src)
+
+    -- test that i and j specify the substring in the same way as string.sub
+    for _, v in ipairs({
+        {},
+        {
+            10,
+        },
+        {
+            -10,
+        },
+        {
+            0,
+        },
+        {
+            10,
+            20,
+        },
+        {
+            -20,
+            -10,
+        },
+        {
+            -200,
+            200,
+        },
+        {
+            20,
+            10,
+        },
+        {
+            1,
+            0,
+        },
+    }) do
+        local i, j = v[1] or 1, v[2] or -1
+        assert.equal(base64.encode(src, i, j), base64.encode(src:sub(i, j)))
+        assert.equal(base64.encodeURL(src, i, j),
+                     base64.encodeURL(src:sub(i, j)))
+        assert.equal(base64.decode(enc, i, j), base64.decode(enc:sub(i, j)))
+        assert.equal(base64.decodeURL(enc_url, i, j),
+                     base64.decodeURL(enc_url:sub(i, j)))
+        assert.equal(base64.decodeMix(enc_url, i, j),
+                     base64.decodeMix(enc_url:sub(i, j)))
+    end
+
+    -- test that the buffer and options can follow i and j
+    local buf = base64.buffer()
+    assert.equal(base64.encode(src, 11, 40, buf), buf)
+    assert.equal(buf:tostring(), base64.encode(src:sub(11, 40)))
+    assert.equal(base64.decode(enc, 5, 20, buf, {
+        threads = 2,
+    }), buf)
+    assert.equal(buf:tostring(), base64.decode(enc:sub(5, 20)))
+    assert.equal(base64.encode(src, 11, nil, buf), buf)
+    assert.equal(buf:tostring(), base64.encode(src:sub(11)))
+    local err = assert.throws(base64.encode, src, 11, nil, {
+        threads = 0,
+    })
+    assert.match(err, 'threads must be greater than 0', false)
+end
+test_substring()
+
+local function test_stats()
+    local stats = base64.stats()
+    assert.match(stats.kernel, '^%a+[%w]*$', false)
+
+    -- test that counters are updated by each call
+    base64.resetStats()
+    stats = base64.stats()
+    assert.equal(stats.encode.calls, 0)
+    assert.equal(stats.decode.calls, 0)
+
+    local enc = base64.encode('hello')
+    base64.decode(enc)
+    base64.decode('invalid=+')
+    local buf = base64.buffer(64)
+    base64.encode('hello', buf)
+    base64.encode('hello', buf)
+    stats = base64.stats()
+    assert.equal(stats.encode.calls, 3)
+    assert.equal(stats.encode.bytes_in, 15)
+    assert.equal(stats.encode.bytes_out, 24)
+    assert.equal(stats.encode.errors, 0)
+    -- the buffer is not reallocated
+    assert.equal(stats.encode.allocs, 1)
+    assert.equal(stats.decode.calls, 2)
+    assert.equal(stats.decode.bytes_in, 8)
+    assert.equal(stats.decode.bytes_out, 5)
+    assert.equal(stats.decode.errors, 1)
+
+    -- test that the functions that do not create a string are counted
+    base64.encodeInt(1, 2)
+    base64.decodeInt('AAE')
+    base64.decodeInt('A+')
+    base64.encodedLen(5)
+    base64.decodedLen(enc)
+    stats = base64.stats()
+    assert.equal(stats.encodeInt.calls, 1)
+    assert.equal(stats.encodeInt.bytes_in, 2)
+    assert.equal(stats.encodeInt.bytes_out, 3)
+    assert.equal(stats.decodeInt.calls, 2)
+    assert.equal(stats.decodeInt.bytes_out, 2)
+    assert.equal(stats.decodeInt.errors, 1)
+    assert.equal(stats.encodedLen.calls, 1)
+    assert.equal(stats.decodedLen.calls, 1)
+
+    -- test that every module function has the counters
+    for name, fn in pairs(base64) do
+        if type(fn) == 'function' and name ~= 'stats' and name ~=
+            'resetStats' and name ~= 'buffer' then
+            assert.equal(type(stats[name]), 'table')
+        end
+    end
+
+    -- test that resetStats clears the counters
+    base64.resetStats()
+    stats = base64.stats()
+    assert.equal(stats.encode.calls, 0)
+    assert.equal(stats.decode.errors, 0)
+    assert.equal(stats.decodeInt.calls, 0)
+end
+test_stats()
+
+local function test_padding()
+    for _, n in ipairs({
+        0,
+        1,
+        2,
+        3,
+        100,
+        1024 * 1024 + 1,
+    }) do
+        local src = randstr(n)
+        local enc = base64.encode(src)
+        local enc_url = base64.encodeURL(src)
+        local nopad = (enc:gsub('=+$', ''))
+
+        -- test that pad option overrides the default padding mode
+        for _, opts in ipairs({
+            {},
+            {
+                threads = 4,
+            },
+        }) do
+            opts.pad = false
+            assert.equal(base64.encode(src, opts), nopad)
+            assert.equal(base64.encodeURL(src, opts), enc_url)
+            opts.pad = true
+            assert.equal(base64.encode(src, opts), enc)
+            local padded = base64.encodeURL(src, opts)
+            assert.equal(#padded, #enc)
+            assert.equal((padded:gsub('=+$', '')), enc_url)
+            assert.equal(base64.decodeURL(padded), src)
+        end
+    end
+
+    -- test that throws an error if invalid pad option
+    local err = assert.throws(base64.encode, 'hello', {
+        pad = 1,
+    })
+    assert.match(err, 'pad must be boolean', false)
+end
+test_padding()
+
+local function test_codec()
+    local STD = 'ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/'
+    local BCRYPT =
+        './ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789'
+    local std = base64.codec(STD, '=')
+    local url = base64.codec(STD:sub(1, 62) .. '-_')
+    local bcrypt = base64.codec(BCRYPT)
+    assert.match(tostring(std), '^base64mix%.codec: ', false)
+
+    for _, n in ipairs({
+        0,
+        1,
+        2,
+        3,
+        100,
+        5000,
+    }) do
+        local src = randstr(n)
+
+        -- test that codecs of the built-in alphabets are compatible
+        local enc = std:encode(src)
+        assert.equal(enc, base64.encode(src))
+        assert.equal(std:decode(enc), src)
+        enc = url:encode(src)
+        assert.equal(enc, base64.encodeURL(src))
+        assert.equal(url:decode(enc), src)
+
+        -- test that the custom alphabet is mapped from the standard alphabet
+        enc = bcrypt:encode(src)
+        local expect = string.gsub(base64.encode(src, {
+            pad = false,
+        }), '.', function(c)
+            local i = string.find(STD, c, 1, true)
+            return BCRYPT:sub(i, i)
+        end)
+        assert.equal(enc, expect)
+        assert.equal(bcrypt:decode(enc), src)
+    end
+
+    -- test that return error if invalid character is contained
+    local _, err = bcrypt:decode('ab+c')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+    _, err = bcrypt:decode('abc=')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that throws an error if invalid alphabet or padchar
+    err = assert.throws(base64.codec, STD:sub(1, 63))
+    assert.match(err, 'alphabet must be 64 unique characters', false)
+    err = assert.throws(base64.codec, 'A' .. STD:sub(2))
+    assert.match(err, 'alphabet must be 64 unique characters', false)
+    err = assert.throws(base64.codec, STD, '+')
+    assert.match(err, 'alphabet must be 64 unique characters', false)
+    err = assert.throws(base64.codec, STD, '==')
+    assert.match(err, 'padchar must be a single character', false)
+end
+test_codec()
+
+local function test_scratch()
+    -- test that the results through the scratch blocks of each size class
+    -- are not affected by the previous calls
+    for _, n in ipairs({
+        3000,
+        12000,
+        48000,
+        49152,
+        70000,
+    }) do
+        for _ = 1, 3 do
+            local src = randstr(n)
+            local enc = base64.encode(src)
+            assert.equal(base64.decode(enc), src)
+            assert.equal(base64.decodeMix(base64.encodeURL(src)), src)
+
+            -- test that the block is released if decoding fails
+            local _, err = base64.decode(enc:sub(1, -5) .. '!!!!')
+            assert.is_nil(_)
+            assert.re_match(err, 'invalid argument', 'i')
+        end
+    end
+
+    -- test that batch functions grow the scratch block
+    local list = {}
+    for i = 1, 5 do
+        list[i] = randstr(i * 15000)
+    end
+    local encs = base64.encodeBatch(list)
+    local decs = base64.decodeBatch(encs)
+    for i = 1, #list do
+        assert.equal(encs[i], base64.encode(list[i]))
+        assert.equal(decs[i], list[i])
+    end
+end
+test_scratch()
+
+local function test_decode_cached()
+    -- test that decodeCached returns the same result as decode functions
+    for _, v in ipairs({
+        {
+            enc = base64.encode,
+        },
+        {
+            enc = base64.encodeURL,
+            alphabet = 'url',
+        },
+        {
+            enc = base64.encodeURL,
+            alphabet = 'mix',
+        },
+    }) do
+        local list = {}
+        for i = 1, 600 do
+            list[i] = randstr(math.random(0, 100))
+        end
+        list[#list + 1] = randstr(1000)
+
+        -- test that the cached results are returned after the eviction
+        for _ = 1, 2 do
+            for i, src in ipairs(list) do
+                local enc = v.enc(src)
+                assert.equal(base64.decodeCached(enc, v.alphabet), src)
+                assert.equal(base64.decodeCached(enc, v.alphabet), src)
+                assert.equal(base64.decodeCached(v.enc(list[1]), v.alphabet),
+                             list[1])
+                assert.equal(base64.decodeCached(v.enc(list[i - 1] or ''),
+                                                 v.alphabet), list[i - 1] or '')
+            end
+        end
+    end
+
+    -- test that the alphabets have separate caches
+    assert.equal(base64.decodeCached('-_-_', 'url'), base64.decodeURL('-_-_'))
+    local _, err = base64.decodeCached('-_-_')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+    _, err = base64.decodeCached('-_-_')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that throws an error if invalid alphabet
+    err = assert.throws(base64.decodeCached, 'abcd', 'foo')
+    assert.match(err, 'invalid option', false)
+end
+test_decode_cached()
+
+local function test_decode_segments()
+    -- test that decodes all segments separated by sep
+    local a, b, c = randstr(10), randstr(100), randstr(5000)
+    local token = table.concat({
+        base64.encodeURL(a),
+        base64.encodeURL(b),
+        base64.encodeURL(c),
+    }, '.')
+    for _, alphabet in ipairs({
+        'url',
+        'mix',
+    }) do
+        local x, y, z, w = base64.decodeSegments(token, '.', alphabet)
+        assert.equal(x, a)
+        assert.equal(y, b)
+        assert.equal(z, c)
+        assert.is_nil(w)
+    end
+    assert.equal(select('#', base64.decodeSegments(token, '.')), 3)
+
+    -- test that the separator can be multiple characters
+    token = base64.encode(a) .. '::' .. base64.encode(c)
+    local x, y = base64.decodeSegments(token, '::', 'std')
+    assert.equal(x, a)
+    assert.equal(y, c)
+
+    -- test that empty segments are decoded into empty strings
+    assert.equal(select('#', base64.decodeSegments('', '.')), 1)
+    assert.equal(base64.decodeSegments('', '.'), '')
+    assert.equal(select('#', base64.decodeSegments('.YWJj.', '.')), 3)
+    x, y = base64.decodeSegments('.YWJj.', '.')
+    assert.equal(x, '')
+    assert.equal(y, 'abc')
+
+    -- test that return error if a segment contains an invalid character
+    local _, err = base64.decodeSegments('YWJj.YW+j', '.')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+    _, err = base64.decodeSegments('YWJj.YW_j', '.', 'std')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that throws an error if sep is empty
+    err = assert.throws(base64.decodeSegments, 'YWJj', '')
+    assert.match(err, 'sep must not be empty', false)
+end
+test_decode_segments()
+
+local function test_transcode()
+    -- test that transcoding is the same as decoding and encoding
+    for _, n in ipairs({
+        0,
+        1,
+        2,
+        3,
+        11, -- padded result whose length is a multiple of 16
+        16,
+        100,
+        5000,
+        71999, -- padded result larger than the scratch blocks
+    }) do
+        local src = randstr(n)
+        local std = base64.encode(src)
+        local url = base64.encodeURL(src)
+        assert.equal(base64.toURL(std), url)
+        assert.equal(base64.toURL(std, true), base64.encodeURL(src, {
+            pad = true,
+        }))
+        assert.equal(base64.toStd(url), std)
+        assert.equal(base64.toStd(base64.toURL(std, true)), std)
+    end
+
+    -- test that the remaining 1 character is discarded
+    for _, n in ipairs({
+        1,
+        5,
+        17,
+        64 * 1024 + 1,
+        96 * 1024 + 5,
+    }) do
+        local std = base64.encode(randstr(n * 3)):sub(1, n)
+        local url = base64.encodeURL(randstr(n * 3)):sub(1, n)
+        local dec = base64.decode(std)
+        assert.equal(base64.toURL(std), base64.encodeURL(dec))
+        assert.equal(base64.toURL(std, true), base64.encodeURL(dec, {
+            pad = true,
+        }))
+        assert.equal(base64.toStd(url),
+                     base64.encode(base64.decodeURL(url)))
+    end
+
+    -- test that the long run of the padding characters is removed
+    assert.equal(base64.toURL('AAAA' .. ('='):rep(28)), 'AAAA')
+    assert.equal(base64.toURL('AAAA' .. ('='):rep(28), true), 'AAAA')
+    assert.equal(base64.toStd('AAAAAA' .. ('='):rep(60)), 'AAAAAA==')
+
+    -- test that the unused bits of the last character are cleared
+    assert.equal(base64.toURL('YWJ='), base64.encodeURL(base64.decode('YWJ=')))
+    assert.equal(base64.toStd('YR'), base64.encode(base64.decode('YR')))
+
+    -- test that return error if invalid character is contained
+    for _, v in ipairs({
+        {
+            fn = base64.toURL,
+            src = 'ab-_',
+        },
+        {
+            fn = base64.toURL,
+            src = 'ab=c',
+        },
+        {
+            fn = base64.toStd,
+            src = 'ab+/',
+        },
+    }) do
+        local _, err = v.fn(v.src)
+        assert.is_nil(_)
+        assert.re_match(err, 'invalid argument', 'i')
+    end
+end
+test_transcode()
+
+local function test_job()
+    -- test that jobs return the same results as the one-shot functions
+    local src = randstr(10000)
+    for _, v in ipairs({
+        {
+            job = base64.encodeJob,
+            src = src,
+            exp = base64.encode(src),
+        },
+        {
+            job = base64.encodeJob,
+            alphabet = 'url',
+            src = src,
+            exp = base64.encodeURL(src),
+        },
+        {
+            job = base64.decodeJob,
+            src = base64.encode(src),
+            exp = src,
+        },
+        {
+            job = base64.decodeJob,
+            alphabet = 'mix',
+            src = base64.encodeURL(src),
+            exp = src,
+        },
+    }) do
+        -- test that each step processes at most step bytes
+        local job = v.job(v.src, v.alphabet, 1000)
+        assert.match(tostring(job), '^base64mix%.job: ', false)
+        assert.is_nil(job:result())
+        local nstep = 1
+        while not job:step() do
+            nstep = nstep + 1
+        end
+        assert.equal(nstep, math.ceil(#v.src / 1000))
+        assert.equal(job:result(), v.exp)
+        assert.is_true(job:step())
+
+        -- test that run completes the job at once
+        job = v.job(v.src, v.alphabet, 7)
+        assert.equal(job:run(), v.exp)
+        assert.equal(job:result(), v.exp)
+
+        -- test that run yields after each step in a coroutine
+        job = v.job(v.src, v.alphabet, 1000)
+        local co = coroutine.wrap(function()
+            return job:run()
+        end)
+        local res = co()
+        if _VERSION ~= 'Lua 5.1' and _VERSION ~= 'Lua 5.2' then
+            nstep = 1
+            while not res do
+                nstep = nstep + 1
+                res = co()
+            end
+            assert.equal(nstep, math.ceil(#v.src / 1000))
+        end
+        assert.equal(res, v.exp)
+    end
+
+    -- test that empty string is processed
+    assert.equal(base64.encodeJob(''):run(), '')
+    assert.equal(base64.decodeJob(''):run(), '')
+
+    -- test that return error if invalid character is contained
+    local job = base64.decodeJob(string.rep('YWJj', 100) .. '!YWJ', nil, 16)
+    local ok, err = job:step()
+    assert.is_false(ok)
+    repeat
+        ok, err = job:step()
+    until ok ~= false
+    assert.is_nil(ok)
+    assert.re_match(err, 'invalid argument', 'i')
+    ok, err = job:result()
+    assert.is_nil(ok)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that throws an error if invalid step
+    err = assert.throws(base64.encodeJob, 'abc', nil, 0)
+    assert.match(err, 'step must be greater than 0', false)
+end
+test_job()
+
+local function test_decode_range()
+    -- test that decodeRange returns the same result as string.sub
+    for _, n in ipairs({
+        0,
+        1,
+        2,
+        3,
+        4,
+        100,
+        5000,
+    }) do
+        local src = randstr(n)
+        local std = base64.encode(src)
+        local url = base64.encodeURL(src)
+        for _ = 1, 50 do
+            local offset = math.random(0, n + 2)
+            local len = math.random(0, n + 2)
+            local exp = src:sub(offset + 1, offset + len)
+            assert.equal(base64.decodeRange(std, offset, len), exp)
+            assert.equal(base64.decodeRange(url, offset, len, 'url'), exp)
+            assert.equal(base64.decodeRange(url, offset, len, 'mix'), exp)
+        end
+    end
+
+    -- test that only the covering groups are validated
+    assert.equal(base64.decodeRange('YWJjZGVm!!!!', 0, 6), 'abcdef')
+    local _, err = base64.decodeRange('YWJjZGVm!!!!', 4, 3)
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that throws an error if negative offset or length
+    err = assert.throws(base64.decodeRange, 'YWJj', -1, 1)
+    assert.match(err, 'offset must not be negative', false)
+    err = assert.throws(base64.decodeRange, 'YWJj', 0, -1)
+    assert.match(err, 'length must not be negative', false)
+end
+test_decode_range()
+
+local function test_zerocopy()
+    -- test that the results of at least zerocopy bytes can be used like
+    -- strings
+    local src = randstr(10000)
+    for _, v in ipairs({
+        {
+            fn = base64.encode,
+            src = src,
+            exp = base64.encode(src),
+        },
+        {
+            fn = base64.encodeURL,
+            src = src,
+            exp = base64.encodeURL(src),
+        },
+        {
+            fn = base64.decode,
+            src = base64.encode(src),
+            exp = src,
+        },
+        {
+            fn = base64.decodeMix,
+            src = base64.encodeURL(src),
+            exp = src,
+        },
+    }) do
+        local res = v.fn(v.src, {
+            zerocopy = 1024,
+        })
+        assert.equal(tostring(res), v.exp)
+        assert.equal(#res, #v.exp)
+        assert.equal(res:len(), #v.exp)
+        assert.equal(res:sub(10, 20), v.exp:sub(10, 20))
+        assert.equal(res:sub(-5), v.exp:sub(-5))
+
+        -- test that the results smaller than zerocopy are strings
+        res = v.fn(v.src, 1, 100, {
+            zerocopy = 1024,
+        })
+        assert.equal(res, v.fn(v.src:sub(1, 100)))
+    end
+
+    -- test that return error if invalid character is contained
+    local _, err = base64.decode(string.rep('YWJj', 1000) .. '!!!!', {
+        zerocopy = 1,
+    })
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that throws an error if invalid zerocopy
+    err = assert.throws(base64.encode, 'abc', {
+        zerocopy = 0,
+    })
+    assert.match(err, 'zerocopy must be greater than 0', false)
+    err = assert.throws(base64.encode, 'abc', {
+        zerocopy = 'foo',
+    })
+    assert.match(err, 'zerocopy must be integer', false)
+end
+test_zerocopy()
+
+local function test_int()
+    -- test that integers are encoded into the big-endian bytes
+    for _, v in ipairs({
+        {
+            n = 0,
+            exp = 'AAAAAAAAAAA',
+        },
+        {
+            n = 1234567890,
+            exp = 'AAAAAEmWAtI',
+        },
+        {
+            n = 1234567890,
+            width = 4,
+            exp = 'SZYC0g',
+        },
+        {
+            n = 255,
+            width = 1,
+            exp = '_w',
+        },
+        {
+            n = 65535,
+            width = 2,
+            exp = '__8',
+        },
+    }) do
+        local enc = base64.encodeInt(v.n, v.width)
+        assert.equal(enc, v.exp)
+        assert.equal(base64.decodeInt(enc), v.n)
+    end
+    for _ = 1, 100 do
+        local n = math.random(0, 2 ^ 31)
+        local enc = base64.encodeInt(n)
+        assert.equal(enc, base64.encodeURL(string.rep('\0', 4) .. string.char(
+                                               math.floor(n / 2 ^ 24) % 256,
+                                               math.floor(n / 2 ^ 16) % 256,
+                                               math.floor(n / 2 ^ 8) % 256,
+                                               n % 256)))
+        assert.equal(base64.decodeInt(enc), n)
+    end
+
+    -- test that binary IDs are encoded as is
+    for _, n in ipairs({
+        1,
+        9,
+        16,
+    }) do
+        local id = randstr(n)
+        local enc = base64.encodeInt(id)
+        assert.equal(enc, base64.encodeURL(id))
+        assert.equal(base64.decodeInt(enc, true), id)
+    end
+
+    -- test that the type of the result does not depend on the length
+    assert.equal(base64.decodeInt(base64.encodeInt(1, 1), true), '\1')
+    local _, err = base64.decodeInt(base64.encodeInt(randstr(9)))
+    assert.is_nil(_)
+    assert.re_match(err, 'range', 'i')
+    _, err = base64.decodeInt(base64.encodeInt(randstr(17)), true)
+    assert.is_nil(_)
+    assert.re_match(err, 'range', 'i')
+
+    -- test the largest integer that can be represented exactly
+    if math.type then
+        assert.equal(base64.decodeInt(base64.encodeInt(-1)), -1)
+        assert.equal(base64.decodeInt(base64.encodeInt(math.maxinteger)),
+                     math.maxinteger)
+    else
+        local enc = base64.encodeURL('\0\32' .. ('\0'):rep(6))
+        assert.equal(base64.decodeInt(enc), 2 ^ 53)
+        enc = base64.encodeURL('\0\32' .. ('\0'):rep(5) .. '\1')
+        _, err = base64.decodeInt(enc)
+        assert.is_nil(_)
+        assert.re_match(err, 'range', 'i')
+    end
+
+    -- test that return error if invalid string
+    _, err = base64.decodeInt('AA+A')
+    assert.is_nil(_)
+    assert.re_match(err, 'invalid argument', 'i')
+    _, err = base64.decodeInt(string.rep('A', 23), true)
+    assert.is_nil(_)
+    assert.re_match(err, 'range', 'i')
+    err = assert.throws(base64.decodeInt, 'AA', 1)
+    assert.match(err, 'boolean expected', false)
+
+    -- test that throws an error if invalid arguments
+    err = assert.throws(base64.encodeInt, 256, 1)
+    assert.match(err, 'integer does not fit into width bytes', false)
+    err = assert.throws(base64.encodeInt, 1, 9)
+    assert.match(err, 'width must be 1 to 8', false)
+    err = assert.throws(base64.encodeInt, randstr(17))
+    assert.match(err, 'string must be 1 to 16 bytes', false)
+    err = assert.throws(base64.encodeInt, 'abc', 3)
+    assert.match(err, 'width cannot be specified for string', false)
+end
+test_int()
+
+local function test_api()
+    -- test that the function table is published to the registry
+    local reg = debug.getregistry()
+    assert.equal(type(reg['base64mix.api']), 'userdata')
+end
+test_api()
+
+local function test_encode_to()
+    local buf = base64.buffer()
+
+    -- test that append the encoded string to the contents of buffer
+    assert.equal(buf:write('Authorization: Basic '), buf)
+    assert.equal(base64.encodeTo(buf, 'user:pass'), buf)
+    assert.equal(buf:write('\r\n'), buf)
+    assert.equal(buf:tostring(), 'Authorization: Basic dXNlcjpwYXNz\r\n')
+
+    -- test that append the encoded substring
+    buf:reset()
+    buf:write('"', 'id', '":"')
+    base64.encodeURLTo(buf, 'xx\255\254\253xx', 3, 5)
+    buf:write('"')
+    assert.equal(buf:tostring(), '"id":"__79"')
+
+    -- test that pad option can be specified
+    buf:reset()
+    base64.encodeTo(buf, 'hello', {
+        pad = false,
+    })
+    base64.encodeURLTo(buf, 'hello', 1, -1, {
+        pad = true,
+    })
+    assert.equal(buf:tostring(), 'aGVsbG8aGVsbG8=')
+
+    -- test that the buffer grows
+    local src = randstr(64 * 1024)
+    buf:reset()
+    for _ = 1, 4 do
+        base64.encodeTo(buf, src)
+    end
+    assert.equal(buf:tostring(), string.rep(base64.encode(src), 4))
+
+    -- test that throws an error if invalid arguments
+    local err = assert.throws(base64.encodeTo, 'foo', 'bar')
+    assert.match(err, 'base64mix.buffer expected', false)
+    err = assert.throws(buf.write, buf, {})
+    assert.match(err, 'string expected', false)
+end
+test_encode_to()
+
+local function test_ffi()
+    -- the FFI binding is only available on LuaJIT
+    if type(jit) ~= 'table' then
+        return
+    end
+    local ffi = require('ffi')
+    local b64ffi = require('base64mix.ffi')
+    assert.equal(b64ffi.kernel, base64.stats().kernel)
+
+    -- test that round-trip through encodeInto and decodeInto
+    for _, n in ipairs({
+        0,
+        1,
+        2,
+        3,
+        100,
+        5000,
+    }) do
+        local src = randstr(n)
+        for _, v in ipairs({
+            {
+                alphabet = 'std',
+                pad = true,
+                encode = base64.encode,
+            },
+            {
+                alphabet = 'url',
+                pad = false,
+                encode = base64.encodeURL,
+            },
+        }) do
+            local len = assert(b64ffi.encodedLen(n, v.pad))
+            local enc = ffi.new('uint8_t[?]', len + 1)
+            local elen = assert(b64ffi.encodeInto(enc, len, src, nil,
+                                                  v.alphabet, v.pad))
+            assert.equal(elen, len)
+            assert.equal(ffi.string(enc, elen), v.encode(src))
+
+            local dlen = b64ffi.decodedLen(enc, elen)
+            assert.equal(dlen, n)
+            local dec = ffi.new('uint8_t[?]', dlen + 1)
+            local m = assert(b64ffi.decodeInto(dec, dlen, enc, elen,
+                                               v.alphabet))
+            assert.equal(ffi.string(dec, m), src)
+        end
+    end
+
+    -- test that decodeInto uses the same default alphabet as decode
+    local dec = ffi.new('uint8_t[16]')
+    assert.equal(b64ffi.decodeInto(dec, 16, 'YWJj'), 3)
+    assert.equal(ffi.string(dec, 3), 'abc')
+    local n, err = b64ffi.decodeInto(dec, 16, '-_-_')
+    assert.is_nil(n)
+    assert.re_match(err, 'invalid argument', 'i')
+    assert.equal(b64ffi.decodeInto(dec, 16, '-_-_', nil, 'mix'), 3)
+
+    -- test that return error if invalid character is contained
+    n, err = b64ffi.decodeInto(dec, 16, 'YW*j')
+    assert.is_nil(n)
+    assert.re_match(err, 'invalid argument', 'i')
+
+    -- test that return error if the destination is too small
+    n, err = b64ffi.encodeInto(dec, 3, 'abc')
+    assert.is_nil(n)
+    assert.re_match(err, 'buffer', 'i')
+    n, err = b64ffi.decodeInto(dec, 2, 'YWJj')
+    assert.is_nil(n)
+    assert.re_match(err, 'buffer', 'i')
+
+    -- test that throws an error if invalid alphabet
+    err = assert.throws(b64ffi.encodeInto, dec, 16, 'abc', nil, 'foo')
+    assert.match(err, 'invalid alphabet', false)
+end
+test_ffi()